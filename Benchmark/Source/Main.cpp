@@ -0,0 +1,546 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Headless render benchmark for JuceSynthPluginAudioProcessor.
+
+    The processor is created without an editor and driven by scripted MIDI
+    across a sweep of scenarios, voice counts, block sizes, sample rates and
+    waveforms. Only processBlock is timed; the MIDI for each block is written
+    before the clock starts. Results go to stdout (or --output) as JSON, one
+    entry per run, with ns per sample, the real-time factor and per-block
+    latency percentiles.
+
+    Usage:
+        CanyaBenchmark [--voices=1,16,64,256] [--blocks=64,256,1024]
+                       [--rates=44100,96000] [--waves=sine,square,triangle,sawtooth,user]
+                       [--scenarios=chords,arpeggio,pad] [--seconds=2]
+                       [--filter-length=101|1023|4095] [--oversampling=1|2|4|8]
+                       [--filter-engine=fir|svf|biquad]
+                       [--fx=chorus,flanger,delay,dcBlocker]
+                       [--sample=file.wav [--stream] [--preload=ms]]
+                       [--wavetable=file.wav [--position=0-1]]
+                       [--unison=1-16] [--multicore] [--tremolo]
+                       [--double] [--output=results.json]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/FIRKernelBank.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    // Order matches the processor's "wave", "filterLength", "oversampling" and "filterEngine" choices.
+    // "user" is the first user wavetable slot, only run when asked for.
+    const juce::StringArray waveNames{ "sine", "square", "triangle", "sawtooth", "user" };
+    const juce::StringArray filterLengthNames{ "101", "1023", "4095" };
+    const juce::StringArray oversamplingNames{ "1", "2", "4", "8" };
+    const juce::StringArray filterEngineNames{ "fir", "svf", "biquad" };
+
+    const juce::StringArray scenarioNames{ "chords", "arpeggio", "pad" };
+
+    constexpr int notesPerChannel = 64;  // notes 36 - 99, then the next MIDI channel
+    constexpr int warmupBlocks = 16;
+
+    struct Options
+    {
+        juce::Array<int> voiceCounts{ 1, 16, 64, 256 };
+        juce::Array<int> blockSizes{ 64, 256, 1024 };
+        juce::Array<double> sampleRates{ 44100.0, 96000.0 };
+        juce::StringArray waves{ "sine", "square", "triangle", "sawtooth" };
+        juce::StringArray scenarios = scenarioNames;
+        double seconds = 2.0;
+        int filterLength = 0;
+        int oversampling = 0;
+        int filterEngine = 0;
+        FxChain effects;
+        juce::File sample;      // plays in "Sample" oscillator mode when set
+        bool stream = false;    // ...through the streamer rather than the mapping
+        double preloadMs = 250.0;
+        juce::File wavetable;   // built into the "user" wave's slot when set
+        float position = 0.0f;
+        int unison = 1;
+        bool multiCore = false;
+        bool tremolo = false;
+        bool doublePrecision = false;
+        juce::File output;
+    };
+
+    struct Run
+    {
+        juce::String scenario;
+        int voices;
+        int blockSize;
+        double sampleRate;
+        juce::String wave;
+    };
+
+    struct ScriptEvent
+    {
+        juce::int64 sample;
+        juce::MidiMessage message;
+    };
+
+    //==============================================================================
+    juce::StringArray splitList(const juce::String& list)
+    {
+        juce::StringArray items;
+        items.addTokens(list, ",", {});
+        items.trim();
+        items.removeEmptyStrings();
+        return items;
+    }
+
+    bool parseOptions(const juce::ArgumentList& args, Options& options)
+    {
+        if (args.containsOption("--voices"))
+        {
+            options.voiceCounts.clear();
+
+            for (auto& s : splitList(args.getValueForOption("--voices")))
+                options.voiceCounts.add(juce::jlimit(1, SynthEngine::maxVoices, s.getIntValue()));
+        }
+
+        if (args.containsOption("--blocks"))
+        {
+            options.blockSizes.clear();
+
+            for (auto& s : splitList(args.getValueForOption("--blocks")))
+                options.blockSizes.add(juce::jmax(1, s.getIntValue()));
+        }
+
+        if (args.containsOption("--rates"))
+        {
+            options.sampleRates.clear();
+
+            for (auto& s : splitList(args.getValueForOption("--rates")))
+                options.sampleRates.add(juce::jmax(8000.0, s.getDoubleValue()));
+        }
+
+        if (args.containsOption("--waves"))
+            options.waves = splitList(args.getValueForOption("--waves"));
+
+        if (args.containsOption("--scenarios"))
+            options.scenarios = splitList(args.getValueForOption("--scenarios"));
+
+        if (args.containsOption("--seconds"))
+            options.seconds = juce::jmax(0.1, args.getValueForOption("--seconds").getDoubleValue());
+
+        if (args.containsOption("--filter-length"))
+            options.filterLength = filterLengthNames.indexOf(args.getValueForOption("--filter-length"));
+
+        if (args.containsOption("--oversampling"))
+            options.oversampling = oversamplingNames.indexOf(args.getValueForOption("--oversampling"));
+
+        if (args.containsOption("--filter-engine"))
+            options.filterEngine = filterEngineNames.indexOf(args.getValueForOption("--filter-engine"));
+
+        if (args.containsOption("--fx"))
+        {
+            const auto names = splitList(args.getValueForOption("--fx"));
+            options.effects = FxChain::fromString(names.joinIntoString(","));
+
+            if (options.effects.size() != names.size())
+            {
+                std::cerr << "Effects must be some of chorus, flanger, delay, dcBlocker, each at most once" << std::endl;
+                return false;
+            }
+        }
+
+        if (args.containsOption("--sample"))
+            options.sample = args.getFileForOption("--sample");
+
+        if (args.containsOption("--preload"))
+            options.preloadMs = juce::jlimit(10.0, 2000.0, args.getValueForOption("--preload").getDoubleValue());
+
+        if (args.containsOption("--wavetable"))
+            options.wavetable = args.getFileForOption("--wavetable");
+
+        if (args.containsOption("--position"))
+            options.position = juce::jlimit(0.0f, 1.0f, args.getValueForOption("--position").getFloatValue());
+
+        if (args.containsOption("--unison"))
+            options.unison = juce::jlimit(1, UnisonOscillator::maxLanes, args.getValueForOption("--unison").getIntValue());
+
+        if (args.containsOption("--output"))
+            options.output = args.getFileForOption("--output");
+
+        options.multiCore = args.containsOption("--multicore");
+        options.tremolo = args.containsOption("--tremolo");
+        options.stream = args.containsOption("--stream");
+        options.doublePrecision = args.containsOption("--double");
+
+        for (auto& w : options.waves)
+        {
+            if (!waveNames.contains(w))
+            {
+                std::cerr << "Unknown wave: " << w << std::endl;
+                return false;
+            }
+        }
+
+        for (auto& s : options.scenarios)
+        {
+            if (!scenarioNames.contains(s))
+            {
+                std::cerr << "Unknown scenario: " << s << std::endl;
+                return false;
+            }
+        }
+
+        if (options.filterLength < 0)
+        {
+            std::cerr << "Filter length must be one of " << filterLengthNames.joinIntoString(", ") << std::endl;
+            return false;
+        }
+
+        if (options.oversampling < 0)
+        {
+            std::cerr << "Oversampling must be one of " << oversamplingNames.joinIntoString(", ") << std::endl;
+            return false;
+        }
+
+        if (options.filterEngine < 0)
+        {
+            std::cerr << "Filter engine must be one of " << filterEngineNames.joinIntoString(", ") << std::endl;
+            return false;
+        }
+
+        if (options.sample != juce::File() && MappedSample::open(options.sample) == nullptr)
+        {
+            std::cerr << "Not a 16, 24 or 32-bit PCM WAV file: " << options.sample.getFullPathName() << std::endl;
+            return false;
+        }
+
+        if (options.stream && options.sample == juce::File())
+        {
+            std::cerr << "--stream needs a --sample to stream" << std::endl;
+            return false;
+        }
+
+        if (options.wavetable != juce::File() && MappedSample::open(options.wavetable) == nullptr)
+        {
+            std::cerr << "Not a 16, 24 or 32-bit PCM WAV file: " << options.wavetable.getFullPathName() << std::endl;
+            return false;
+        }
+
+        if (options.waves.contains("user") && options.wavetable == juce::File())
+        {
+            std::cerr << "--waves=user needs a --wavetable to play" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    juce::MidiMessage noteOn(int voice)
+    {
+        return juce::MidiMessage::noteOn(1 + voice / notesPerChannel, 36 + voice % notesPerChannel, (juce::uint8) 100);
+    }
+
+    juce::MidiMessage noteOff(int voice)
+    {
+        return juce::MidiMessage::noteOff(1 + voice / notesPerChannel, 36 + voice % notesPerChannel);
+    }
+
+    // Every scenario ends up with run.voices notes held at once, which is also
+    // the polyphony the run is given, so the steady state is exactly that many
+    // sounding voices plus whatever is stolen or releasing in between.
+    std::vector<ScriptEvent> createScript(const Run& run, juce::int64 length)
+    {
+        std::vector<ScriptEvent> events;
+        const double sr = run.sampleRate;
+
+        if (run.scenario == "pad")
+        {
+            // Everything held for the whole run: envelopes sit in sustain.
+            for (int v = 0; v < run.voices; ++v)
+                events.push_back({ 0, noteOn(v) });
+        }
+        else if (run.scenario == "chords")
+        {
+            // A chord every half second, released after 400 ms, so the release
+            // tails of one chord overlap the attack of the next.
+            const auto period = (juce::int64) (0.5 * sr);
+            const auto hold = (juce::int64) (0.4 * sr);
+
+            for (juce::int64 t = 0; t < length; t += period)
+            {
+                for (int v = 0; v < run.voices; ++v)
+                {
+                    events.push_back({ t, noteOn(v) });
+                    events.push_back({ t + hold, noteOff(v) });
+                }
+            }
+        }
+        else if (run.scenario == "arpeggio")
+        {
+            // One note per step, each held for run.voices steps. Steps are 1/32
+            // notes at 120 bpm, shortened so the stack is full by half-way.
+            const double stepSeconds = juce::jmin(0.0625, 0.5 * (double) length / sr / run.voices);
+            const auto step = juce::jmax((juce::int64) 1, (juce::int64) (stepSeconds * sr));
+            int index = 0;
+
+            for (juce::int64 t = 0; t < length; t += step, ++index)
+            {
+                const int v = index % run.voices;
+                events.push_back({ t, noteOn(v) });
+                events.push_back({ t + step * run.voices - 1, noteOff(v) });
+            }
+        }
+
+        std::stable_sort(events.begin(), events.end(),
+                         [](const ScriptEvent& a, const ScriptEvent& b) { return a.sample < b.sample; });
+        return events;
+    }
+
+    //==============================================================================
+    void setParameter(juce::AudioProcessorValueTreeState& apvts, const juce::String& id, float value)
+    {
+        if (auto* p = apvts.getParameter(id))
+            p->setValueNotifyingHost(p->convertTo0to1(value));
+    }
+
+    double percentile(const std::vector<double>& sorted, double fraction)
+    {
+        if (sorted.empty())
+            return 0.0;
+
+        const auto index = (size_t) juce::jlimit(0, (int) sorted.size() - 1,
+                                                 (int) std::ceil(fraction * (double) sorted.size()) - 1);
+        return sorted[index];
+    }
+
+    template <typename SampleType>
+    juce::var runBenchmark(const Run& run, const Options& options, FIRKernelBank& kernelBank)
+    {
+        JuceSynthPluginAudioProcessor processor;
+        auto& apvts = processor.apvts;
+
+        setParameter(apvts, "wave", (float) waveNames.indexOf(run.wave));
+        setParameter(apvts, "polyphony", (float) run.voices);
+        setParameter(apvts, "multiCoreRendering", options.multiCore ? 1.0f : 0.0f);
+        setParameter(apvts, "filterLength", (float) options.filterLength);
+        setParameter(apvts, "oversampling", (float) options.oversampling);
+        setParameter(apvts, "filterEngine", (float) options.filterEngine);
+        setParameter(apvts, "unisonVoices", (float) options.unison);
+        setParameter(apvts, "tremoloOn", options.tremolo ? 1.0f : 0.0f);
+        processor.setEffectsChain(options.effects);
+
+        if (options.sample != juce::File())
+        {
+            // The preload is cut when the sample loads.
+            setParameter(apvts, "samplePreload", (float) options.preloadMs);
+            setParameter(apvts, "sampleStreaming", options.stream ? 1.0f : 0.0f);
+            processor.loadSample(options.sample);
+            setParameter(apvts, "oscillatorMode", 1.0f);
+            setParameter(apvts, "sampleLoop", 1.0f);
+        }
+
+        double wavetableBuildMs = 0.0;
+
+        if (options.wavetable != juce::File())
+        {
+            // Built on the bank's thread; the first warm-up block picks it up.
+            const auto buildStart = juce::Time::getMillisecondCounterHiRes();
+            processor.loadWavetable(0, options.wavetable);
+
+            while (processor.isWavetableBuilding())
+                juce::Thread::sleep(1);
+
+            wavetableBuildMs = juce::Time::getMillisecondCounterHiRes() - buildStart;
+            setParameter(apvts, "wavetablePosition", options.position);
+        }
+
+        processor.setProcessingPrecision(std::is_same_v<SampleType, double> ? juce::AudioProcessor::doublePrecision
+                                                                            : juce::AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails(run.sampleRate, run.blockSize);
+        processor.prepareToPlay(run.sampleRate, run.blockSize);
+
+        // Until the bank has built this rate's kernels, the FIR filters keep
+        // the kernel they were constructed with and ask for the right one
+        // every block; the first runs at each rate would then time those
+        // retries and the eventual swap instead of the settings under test.
+        if (filterEngineNames[options.filterEngine] == "fir")
+        {
+            const int taps = filterLengthNames[options.filterLength].getIntValue();
+            auto table = kernelBank.getTable(run.sampleRate, taps);
+
+            while (!table->isComplete())
+                juce::Thread::sleep(10);
+        }
+
+        const int numChannels = processor.getTotalNumOutputChannels();
+        juce::AudioBuffer<SampleType> buffer(numChannels, run.blockSize);
+        juce::MidiBuffer midi;
+        midi.ensureSize(4096);
+
+        // Touch every buffer and cache once before anything is measured.
+        for (int i = 0; i < warmupBlocks; ++i)
+        {
+            midi.clear();
+            processor.processBlock(buffer, midi);
+        }
+
+        processor.resetStreamingStatistics();
+
+        const auto length = (juce::int64) (options.seconds * run.sampleRate);
+        const auto script = createScript(run, length);
+        const int numBlocks = (int) ((length + run.blockSize - 1) / run.blockSize);
+
+        std::vector<double> blockNanos;
+        blockNanos.reserve((size_t) numBlocks);
+
+        size_t nextEvent = 0;
+        double totalNanos = 0.0;
+        SampleType peak = 0;
+        const double nanosPerTick = 1.0e9 / (double) juce::Time::getHighResolutionTicksPerSecond();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            const auto blockStart = (juce::int64) b * run.blockSize;
+            const auto blockEnd = blockStart + run.blockSize;
+
+            midi.clear();
+
+            for (; nextEvent < script.size() && script[nextEvent].sample < blockEnd; ++nextEvent)
+                midi.addEvent(script[nextEvent].message, (int) (script[nextEvent].sample - blockStart));
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            processor.processBlock(buffer, midi);
+            const auto end = juce::Time::getHighResolutionTicks();
+
+            const double nanos = (double) (end - start) * nanosPerTick;
+            blockNanos.push_back(nanos);
+            totalNanos += nanos;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                peak = juce::jmax(peak, buffer.getMagnitude(ch, 0, run.blockSize));
+        }
+
+        processor.releaseResources();
+
+        const double numFrames = (double) numBlocks * run.blockSize;
+        const double deadlineNanos = 1.0e9 * run.blockSize / run.sampleRate;
+        const auto overruns = std::count_if(blockNanos.begin(), blockNanos.end(),
+                                            [deadlineNanos](double n) { return n > deadlineNanos; });
+
+        std::sort(blockNanos.begin(), blockNanos.end());
+
+        auto* latency = new juce::DynamicObject();
+        latency->setProperty("p50", percentile(blockNanos, 0.50));
+        latency->setProperty("p90", percentile(blockNanos, 0.90));
+        latency->setProperty("p99", percentile(blockNanos, 0.99));
+        latency->setProperty("p999", percentile(blockNanos, 0.999));
+        latency->setProperty("max", blockNanos.empty() ? 0.0 : blockNanos.back());
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("scenario", run.scenario);
+        result->setProperty("voices", run.voices);
+        result->setProperty("block_size", run.blockSize);
+        result->setProperty("sample_rate", run.sampleRate);
+        result->setProperty("wave", run.wave);
+        result->setProperty("blocks", numBlocks);
+        result->setProperty("ns_per_sample", totalNanos / numFrames);
+        result->setProperty("realtime_factor", totalNanos > 0.0 ? numFrames / run.sampleRate * 1.0e9 / totalNanos : 0.0);
+        result->setProperty("block_latency_ns", juce::var(latency));
+        result->setProperty("deadline_ns", deadlineNanos);
+        result->setProperty("overruns", (int) overruns);
+        result->setProperty("peak", peak);
+
+        if (options.stream)
+        {
+            const int lowest = processor.getLowestStreamingPrefetch();
+            result->setProperty("underrun_samples", processor.getStreamingUnderruns());
+            result->setProperty("lowest_prefetch_frames", lowest == std::numeric_limits<int>::max() ? -1 : lowest);
+        }
+
+        if (options.wavetable != juce::File())
+            result->setProperty("wavetable_build_ms", wavetableBuildMs);
+
+        return juce::var(result);
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The processor's AsyncUpdater and APVTS expect a message manager.
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    Options options;
+
+    if (!parseOptions(juce::ArgumentList(argc, argv), options))
+        return 1;
+
+    // Keeps the kernel tables alive between runs, so each is only built once.
+    juce::SharedResourcePointer<FIRKernelBank> kernelBank;
+
+    std::vector<Run> runs;
+
+    for (auto& scenario : options.scenarios)
+        for (auto sampleRate : options.sampleRates)
+            for (auto blockSize : options.blockSizes)
+                for (auto voices : options.voiceCounts)
+                    for (auto& wave : options.waves)
+                        runs.push_back({ scenario, voices, blockSize, sampleRate, wave });
+
+    juce::Array<juce::var> results;
+
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        const auto& run = runs[i];
+
+        std::cerr << "[" << (i + 1) << "/" << runs.size() << "] " << run.scenario
+                  << ", " << run.voices << " voices, " << run.blockSize << " samples, "
+                  << run.sampleRate << " Hz, " << run.wave << std::endl;
+
+        results.add(options.doublePrecision ? runBenchmark<double>(run, options, *kernelBank)
+                                            : runBenchmark<float>(run, options, *kernelBank));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("benchmark", "JuceSynthPluginAudioProcessor::processBlock");
+    root->setProperty("seconds_per_run", options.seconds);
+    root->setProperty("filter_taps", filterLengthNames[options.filterLength].getIntValue());
+    root->setProperty("filter_engine", filterEngineNames[options.filterEngine]);
+    root->setProperty("effects", options.effects.toString());
+    root->setProperty("sample", options.sample.getFullPathName());
+    root->setProperty("stream", options.stream);
+    root->setProperty("preload_ms", options.preloadMs);
+    root->setProperty("wavetable", options.wavetable.getFullPathName());
+    root->setProperty("position", options.position);
+    root->setProperty("oversampling", oversamplingNames[options.oversampling].getIntValue());
+    root->setProperty("unison", options.unison);
+    root->setProperty("multi_core", options.multiCore);
+    root->setProperty("tremolo", options.tremolo);
+    root->setProperty("double_precision", options.doublePrecision);
+    root->setProperty("cpus", juce::SystemStats::getNumCpus());
+    root->setProperty("runs", results);
+
+    const auto json = juce::JSON::toString(juce::var(root));
+
+    if (options.output != juce::File())
+    {
+        if (!options.output.replaceWithText(json))
+        {
+            std::cerr << "Couldn't write " << options.output.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        std::cout << json << std::endl;
+    }
+
+    return 0;
+}
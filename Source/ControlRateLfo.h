@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    ControlRateLfo.h
+
+    Low-frequency modulation source evaluated at control rate. The waveform
+    is only computed at control points a fixed time apart (converted to
+    samples at the host rate, so the control rate doesn't move with it);
+    the samples in between are a straight line to the next control point,
+    written by a loop with independent iterations that the compiler
+    vectorises.
+
+    What a control point holds is up to the caller: render() passes the raw
+    bipolar wave value and the point's block offset to a mapping function,
+    so depth, offset and any other per-block ramp are folded into the
+    control points instead of costing a pass per sample.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "ParameterSnapshot.h"
+#include "WaveFormSettings.h"
+#include "DspContext.h"
+#include <cmath>
+
+class ControlRateLfo
+{
+public:
+    // About 32 samples at 44.1 and 48 kHz. Even a 20 Hz LFO gets some 70
+    // points per cycle, and none of the shapes needs more.
+    static constexpr double defaultControlIntervalMs = 0.7;
+
+    ControlRateLfo() = default;
+
+    // The LFOs run at the host rate, whatever the oscillators' oversampling.
+    void prepare(const DspContext& context, double controlIntervalMs = defaultControlIntervalMs) noexcept
+    {
+        controlInterval = juce::jmax(1, juce::roundToInt(context.millisecondsToSamples(controlIntervalMs)));
+        cyclesPerHz = context.increment((double) controlInterval);
+        reset();
+    }
+
+    // startPhase (0 - 1) offsets the wave, e.g. a quarter cycle between channels.
+    void reset(double startPhase = 0.0) noexcept
+    {
+        phase = startPhase;
+        value = slope = 0.0;
+        samplesLeft = 0;
+        hasValue = false;
+    }
+
+    int getControlInterval() const noexcept { return controlInterval; }
+
+    // Fills dest[0 .. numSamples) with map(blockOffset, wave(phase)) at every
+    // control point and linear interpolation in between. The segment in
+    // progress carries over into the next call, so block size doesn't matter.
+    template <typename SampleType, typename MapFunction>
+    void render(SampleType* dest, int numSamples, WaveFormSettings::WaveForms wave,
+                const ParameterSnapshot::Ramp& frequency, MapFunction&& map) noexcept
+    {
+        for (int i = 0; i < numSamples;)
+        {
+            if (samplesLeft == 0)
+                startSegment(i, numSamples, wave, frequency, map);
+
+            const int count = juce::jmin(samplesLeft, numSamples - i);
+            const SampleType start = (SampleType) value;
+            const SampleType step = (SampleType) slope;
+            SampleType* d = dest + i;
+
+            for (int k = 0; k < count; ++k)
+                d[k] = start + step * (SampleType) k;
+
+            value += slope * count;
+            samplesLeft -= count;
+            i += count;
+        }
+    }
+
+    // Bipolar wave value for a phase in [0, 1), with the same shapes as the
+    // oscillator: square is -1 then +1, triangle is -1 at 0 and +1 at 0.5,
+    // saw ramps from -1 to +1.
+    static double evaluate(WaveFormSettings::WaveForms wave, double p) noexcept
+    {
+        switch (wave)
+        {
+            case WaveFormSettings::WaveForms::sine:     return std::sin(juce::MathConstants<double>::twoPi * p);
+            case WaveFormSettings::WaveForms::square:   return p < 0.5 ? -1.0 : 1.0;
+            case WaveFormSettings::WaveForms::triangle: return p < 0.5 ? 4.0 * p - 1.0 : 3.0 - 4.0 * p;
+            case WaveFormSettings::WaveForms::sawtooth: return 2.0 * p - 1.0;
+        }
+
+        return 0.0;
+    }
+
+private:
+    int controlInterval = 31;           // samples; prepare() works it out from the time
+    double cyclesPerHz = 31 / 44100.0;  // phase advance per segment at 1 Hz
+
+    double phase = 0.0;     // 0..1, at the end of the current segment
+    double value = 0.0;     // output at the next sample to be written
+    double slope = 0.0;     // per sample, towards the next control point
+    int samplesLeft = 0;    // in the current segment
+    bool hasValue = false;
+
+    template <typename MapFunction>
+    void startSegment(int offset, int numSamples, WaveFormSettings::WaveForms wave,
+                      const ParameterSnapshot::Ramp& frequency, MapFunction& map) noexcept
+    {
+        // The very first point is taken where we are; after that each segment
+        // starts where the previous one ended, so the output never jumps.
+        if (!hasValue)
+        {
+            value = (double) map(offset, evaluate(wave, phase));
+            hasValue = true;
+        }
+
+        phase += (double) frequency.at(offset) * cyclesPerHz;
+        phase -= std::floor(phase);
+
+        const int target = juce::jmin(offset + controlInterval, numSamples);
+        slope = ((double) map(target, evaluate(wave, phase)) - value) / controlInterval;
+        samplesLeft = controlInterval;
+    }
+};
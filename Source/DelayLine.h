@@ -0,0 +1,201 @@
+/*
+  ==============================================================================
+
+    DelayLine.h
+
+    A delay line over a power-of-two ring buffer that it doesn't own; the
+    storage comes from a DelayLineArena, sized to the delay actually needed,
+    so a line costs its maximum delay rather than maxiDelayline's fixed
+    88200 * 8 doubles. Wrapping is a mask, never a compare or a modulo.
+
+    Every read is relative to the write position, the slot the next sample
+    goes into: a delay of d returns the sample written d samples before it,
+    so d = 1 is the most recent one. The block read of n samples lines up
+    with the n samples about to be written, which is what a feedback loop
+    wants (the delay must then be at least n). Code that writes the block
+    first adds n to the delay.
+
+    Fractional delays are read either with third-order Lagrange
+    interpolation, which is stateless and fine for modulated delays, or a
+    first-order Thiran allpass, which has a flat magnitude response and so
+    suits fixed delays inside a feedback loop (a plucked string, say); the
+    allpass keeps one sample of state, owned by the caller.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+
+template <typename SampleType>
+class DelayLine
+{
+public:
+    // Samples past the delay that the Lagrange read touches.
+    static constexpr int interpolationMargin = 3;
+
+    // The shortest delay readAllpass plays as asked; see splitAllpassDelay.
+    static constexpr double minimumAllpassDelay = 1.618;
+
+    DelayLine() = default;
+
+    // size must be a power of two; the storage must outlive the line.
+    DelayLine(SampleType* storage, int size) noexcept
+        : buffer(storage), mask(size - 1)
+    {
+        jassert(size > 0 && juce::isPowerOfTwo(size));
+    }
+
+    bool isValid() const noexcept { return buffer != nullptr; }
+    int getSize() const noexcept { return mask + 1; }
+
+    // The longest delay every read supports.
+    int getMaximumDelay() const noexcept { return mask - interpolationMargin; }
+
+    void reset() noexcept
+    {
+        if (buffer != nullptr)
+            std::fill(buffer, buffer + getSize(), SampleType(0));
+
+        writePosition = 0;
+    }
+
+    //==============================================================================
+    void push(SampleType x) noexcept
+    {
+        buffer[writePosition] = x;
+        writePosition = (writePosition + 1) & mask;
+    }
+
+    // 1 <= delay <= getMaximumDelay()
+    SampleType read(int delay) const noexcept
+    {
+        return buffer[(writePosition - delay) & mask];
+    }
+
+    SampleType readLagrange(SampleType delay) const noexcept
+    {
+        return lagrange(writePosition, delay);
+    }
+
+    // state is the allpass's previous output; keep one per tap and zero it
+    // when the line is reset.
+    SampleType readAllpass(SampleType delay, SampleType& state) const noexcept
+    {
+        SampleType alpha;
+        const int whole = splitAllpassDelay(delay, alpha);
+        const SampleType newer = buffer[(writePosition - whole) & mask];
+        const SampleType older = buffer[(writePosition - whole - 1) & mask];
+
+        state = older + alpha * (newer - state);
+        return state;
+    }
+
+    //==============================================================================
+    // Block versions: at most getSize() samples at a time.
+    void write(const SampleType* in, int numSamples) noexcept
+    {
+        jassert(numSamples <= getSize());
+
+        const int first = juce::jmin(numSamples, getSize() - writePosition);
+        std::copy(in, in + first, buffer + writePosition);
+        std::copy(in + first, in + numSamples, buffer);
+        writePosition = (writePosition + numSamples) & mask;
+    }
+
+    // out[i] is the sample delay before writePosition + i.
+    void read(SampleType* out, int delay, int numSamples) const noexcept
+    {
+        const int start = (writePosition - delay) & mask;
+        const int first = juce::jmin(numSamples, getSize() - start);
+        std::copy(buffer + start, buffer + start + first, out);
+        std::copy(buffer, buffer + (numSamples - first), out + first);
+    }
+
+    // A modulated delay: out[i] is delays[i] before writePosition + i.
+    // The iterations don't depend on each other.
+    void readLagrange(SampleType* out, const SampleType* delays, int numSamples) const noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            out[i] = lagrange(writePosition + i, delays[i]);
+    }
+
+    // A fixed fractional delay through the allpass. Shorter delays than
+    // minimumAllpassDelay are read at that delay.
+    void readAllpass(SampleType* out, SampleType delay, int numSamples, SampleType& state) const noexcept
+    {
+        SampleType alpha;
+        const int whole = splitAllpassDelay(delay, alpha);
+        SampleType y = state;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const int position = writePosition + i - whole;
+            y = buffer[(position - 1) & mask] + alpha * (buffer[position & mask] - y);
+            out[i] = y;
+        }
+
+        state = y;
+    }
+
+private:
+    SampleType* buffer = nullptr;
+    int mask = 0;
+    int writePosition = 0;
+
+    // The whole-sample part of the delay and the allpass coefficient for the
+    // rest. The coefficient nears 1 as the fraction goes to 0, which rings,
+    // so a sample is borrowed to keep the fraction above 0.618. That needs
+    // a whole part of at least 1 to borrow from: with none, the read would
+    // reach the slot about to be written, and with just 1 there is nothing
+    // to borrow. Hence the clamp.
+    static int splitAllpassDelay(SampleType delay, SampleType& alpha) noexcept
+    {
+        jassert(delay >= SampleType(minimumAllpassDelay));
+        delay = juce::jmax(delay, SampleType(minimumAllpassDelay));
+
+        int whole = (int) delay;
+        SampleType fraction = delay - (SampleType) whole;
+
+        if (fraction < SampleType(0.618) && whole > 1)
+        {
+            --whole;
+            fraction += 1;
+        }
+
+        alpha = (1 - fraction) / (1 + fraction);
+        return whole;
+    }
+
+    // Four points around the delay, the read position between the second
+    // and third where there is room, between the first and second for
+    // delays under 2.
+    SampleType lagrange(int position, SampleType delay) const noexcept
+    {
+        int whole = (int) delay;
+        SampleType f = delay - (SampleType) whole;
+
+        if (whole > 1)
+        {
+            --whole;
+            f += 1;
+        }
+
+        const int newest = position - whole;
+        const SampleType x0 = buffer[newest & mask];
+        const SampleType x1 = buffer[(newest - 1) & mask];
+        const SampleType x2 = buffer[(newest - 2) & mask];
+        const SampleType x3 = buffer[(newest - 3) & mask];
+
+        const SampleType d1 = f - 1;
+        const SampleType d2 = f - 2;
+        const SampleType d3 = f - 3;
+        const SampleType sixth = SampleType(1) / SampleType(6);
+
+        return x0 * (-d1 * d2 * d3 * sixth)
+             + x1 * (f * d2 * d3 * SampleType(0.5))
+             + x2 * (-f * d1 * d3 * SampleType(0.5))
+             + x3 * (f * d1 * d2 * sixth);
+    }
+};
@@ -0,0 +1,55 @@
+/*
+  ==============================================================================
+
+    DelayLineArena.cpp
+
+  ==============================================================================
+*/
+
+#include "DelayLineArena.h"
+
+void DelayLineArena::clear() noexcept
+{
+    slots.clear();
+}
+
+int DelayLineArena::reserve(int maximumDelaySamples)
+{
+    jassert(maximumDelaySamples >= 1);
+
+    Slot slot;
+    slot.maximumDelay = juce::jmax(1, maximumDelaySamples);
+    slots.push_back(slot);
+
+    return (int) slots.size() - 1;
+}
+
+void DelayLineArena::allocate(int maximumBlockSize, bool doublePrecision)
+{
+    size_t total = 0;
+
+    for (auto& slot : slots)
+    {
+        // getMaximumDelay() is size - 1 - interpolationMargin.
+        const int needed = slot.maximumDelay + maximumBlockSize + DelayLine<float>::interpolationMargin + 1;
+        slot.size = juce::nextPowerOfTwo(needed);
+        slot.offset = total;
+        total += (size_t) slot.size;
+    }
+
+    if (doublePrecision)
+    {
+        storageDouble.assign(total, 0.0);
+        storage = {};
+    }
+    else
+    {
+        storage.assign(total, 0.0f);
+        storageDouble = {};
+    }
+}
+
+size_t DelayLineArena::getBytesAllocated() const noexcept
+{
+    return storage.size() * sizeof(float) + storageDouble.size() * sizeof(double);
+}
@@ -0,0 +1,78 @@
+/*
+  ==============================================================================
+
+    DelayLineArena.h
+
+    One block of memory per processor that every DelayLine it runs is cut
+    from. While preparing, each user reserves the longest delay it will
+    need and gets back a slot number; allocate() then sizes every slot to
+    the next power of two that holds that delay plus a block's worth of
+    samples (for code that writes a block before reading it) and the
+    interpolation margin, and allocates them all at once in the precision
+    the host renders in. The footprint is the sum of what was asked for,
+    rounded up per line, and nothing is allocated after that.
+
+    Lines are handed out as DelayLine views into the block. allocate()
+    moves the storage, so users fetch their lines again after every
+    prepare; nothing on the audio thread reserves or allocates.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "DelayLine.h"
+#include <type_traits>
+#include <vector>
+
+class DelayLineArena
+{
+public:
+    DelayLineArena() = default;
+
+    // Forgets every reservation. Not realtime safe, like the rest of the set-up.
+    void clear() noexcept;
+
+    // Returns the slot to pass to getLine().
+    int reserve(int maximumDelaySamples);
+
+    // Sizes and zeroes every reserved line for blocks of up to maximumBlockSize.
+    void allocate(int maximumBlockSize, bool doublePrecision);
+
+    int getNumLines() const noexcept { return (int) slots.size(); }
+    size_t getBytesAllocated() const noexcept;
+
+    // A view of a slot in the precision it was allocated in.
+    template <typename SampleType>
+    DelayLine<SampleType> getLine(int slot) noexcept
+    {
+        auto& storage = getStorage<SampleType>();
+        const auto& s = slots[(size_t) slot];
+        jassert(s.offset + (size_t) s.size <= storage.size());
+
+        return { storage.data() + s.offset, s.size };
+    }
+
+private:
+    struct Slot
+    {
+        int maximumDelay = 0;
+        int size = 0;
+        size_t offset = 0;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<float> storage;
+    std::vector<double> storageDouble;
+
+    template <typename SampleType>
+    std::vector<SampleType>& getStorage() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return storageDouble;
+        else
+            return storage;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(DelayLineArena)
+};
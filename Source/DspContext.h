@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    DspContext.h
+
+    How one processor instance is running: its sample rate, the rate the
+    oscillators run at after oversampling, the block size and the sample
+    precision. The processor owns one and fills it in while preparing;
+    voices, oscillators, envelopes, LFOs and the mod matrix read it instead
+    of process-wide state, so instances at different rates (a live one and
+    an offline bounce, say) never see each other's settings.
+
+    The reciprocals are worked out here, once, so per-note and per-block
+    code multiplies instead of dividing.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+struct DspContext
+{
+    double sampleRate = 44100.0;
+    double inverseSampleRate = 1.0 / 44100.0;
+
+    int oversamplingFactor = 1;
+    double oscillatorSampleRate = 44100.0;        // sampleRate * oversamplingFactor
+    double inverseOscillatorSampleRate = 1.0 / 44100.0;
+
+    int maximumBlockSize = 512;
+    bool doublePrecision = false;
+
+    // prepareToPlay: everything but the oversampling, which keeps its factor.
+    void prepare(double newSampleRate, int newMaximumBlockSize, bool useDoublePrecision) noexcept
+    {
+        jassert(newSampleRate > 0.0);
+
+        sampleRate = newSampleRate;
+        inverseSampleRate = 1.0 / newSampleRate;
+        maximumBlockSize = newMaximumBlockSize;
+        doublePrecision = useDoublePrecision;
+        setOversamplingFactor(oversamplingFactor);
+    }
+
+    void setOversamplingFactor(int factor) noexcept
+    {
+        oversamplingFactor = factor;
+        oscillatorSampleRate = sampleRate * factor;
+        inverseOscillatorSampleRate = inverseSampleRate / factor;
+    }
+
+    // Oscillator phase increment, in cycles per oscillator sample.
+    double oscillatorIncrement(double hz) const noexcept { return hz * inverseOscillatorSampleRate; }
+
+    // Cycles per host sample, for things that run at the host rate.
+    double increment(double hz) const noexcept { return hz * inverseSampleRate; }
+
+    double millisecondsToSamples(double ms) const noexcept { return ms * 0.001 * sampleRate; }
+};
@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+    FIRKernelBank.cpp
+
+  ==============================================================================
+*/
+
+#include "FIRKernelBank.h"
+#include "FIRfilter.h"
+
+FIRKernelBank::Table::Table(double rate, int numTaps)
+    : sampleRate(rate),
+    taps(numTaps),
+    partitioned(isPartitioned(numTaps)),
+    kernelSize(partitioned ? 2 * getNumPartitions(numTaps) * numBins : numTaps),
+    storage((size_t) numFrequencies * (size_t) kernelSize, 0.0f)
+{
+    for (auto& k : kernels)
+        k.store(nullptr, std::memory_order_relaxed);
+}
+
+void FIRKernelBank::Table::build(int index)
+{
+    if (getLowPass(index) != nullptr)
+        return;
+
+    float* kernel = storage.data() + (size_t) index * (size_t) kernelSize;
+    const float cutoff = juce::jmin(frequencyForIndex(index), (float) (sampleRate * 0.49));
+
+    if (!partitioned)
+    {
+        FIRFilter<float>::generateCoefficients(cutoff, sampleRate, kernel, taps);
+    }
+    else
+    {
+        // Each partition zero-padded to twice its length, as the filter's
+        // overlap-save convolution expects.
+        const int numPartitions = getNumPartitions(taps);
+        std::vector<float> coefficients((size_t) taps);
+        std::vector<SimpleFFT<float>::Complex> scratch((size_t) (2 * partitionSize));
+        SimpleFFT<float> fft(2 * partitionSize);
+
+        FIRFilter<float>::generateCoefficients(cutoff, sampleRate, coefficients.data(), taps);
+
+        float* re = kernel;
+        float* im = kernel + numPartitions * numBins;
+
+        for (int p = 0; p < numPartitions; p++)
+        {
+            std::fill(scratch.begin(), scratch.end(), SimpleFFT<float>::Complex());
+
+            for (int i = 0; i < partitionSize && p * partitionSize + i < taps; i++)
+                scratch[(size_t) i] = coefficients[(size_t) (p * partitionSize + i)];
+
+            fft.forward(scratch.data());
+
+            for (int k = 0; k < numBins; k++)
+            {
+                re[p * numBins + k] = scratch[(size_t) k].real();
+                im[p * numBins + k] = scratch[(size_t) k].imag();
+            }
+        }
+    }
+
+    kernels[(size_t) index].store(kernel, std::memory_order_release);
+    numBuilt.fetch_add(1, std::memory_order_acq_rel);
+}
+
+//==============================================================================
+FIRKernelBank::FIRKernelBank()
+    : juce::Thread("FIR kernel bank")
+{
+    startThread(juce::Thread::Priority::low);
+}
+
+FIRKernelBank::~FIRKernelBank()
+{
+    stopThread(2000);
+}
+
+FIRKernelBank::Table::Ptr FIRKernelBank::getTable(double sampleRate, int numTaps)
+{
+    const juce::ScopedLock sl(lock);
+
+    for (auto* t : tables)
+        if (t->taps == numTaps && juce::approximatelyEqual(t->sampleRate, sampleRate))
+            return t;
+
+    // Drop tables nobody but the bank is holding on to any more.
+    for (int i = tables.size(); --i >= 0;)
+        if (tables.getUnchecked(i)->getReferenceCount() == 1)
+            tables.remove(i);
+
+    Table::Ptr table = new Table(sampleRate, numTaps);
+    tables.add(table.get());
+    notify();
+
+    return table;
+}
+
+int FIRKernelBank::indexForFrequency(float hz) noexcept
+{
+    const float steps = std::log2(juce::jmax(hz, minFrequency) / minFrequency) * (float) stepsPerOctave;
+    return juce::jlimit(0, numFrequencies - 1, juce::roundToInt(steps));
+}
+
+float FIRKernelBank::frequencyForIndex(int index) noexcept
+{
+    return minFrequency * std::exp2((float) index / (float) stepsPerOctave);
+}
+
+FIRKernelBank::Table::Ptr FIRKernelBank::findIncompleteTable()
+{
+    const juce::ScopedLock sl(lock);
+
+    for (auto* t : tables)
+        if (!t->isComplete())
+            return t;
+
+    return nullptr;
+}
+
+void FIRKernelBank::run()
+{
+    while (!threadShouldExit())
+    {
+        auto table = findIncompleteTable();
+
+        if (table == nullptr)
+        {
+            wait(-1);
+            continue;
+        }
+
+        int next = 0;
+
+        while (!table->isComplete() && !threadShouldExit())
+        {
+            // Kernels a voice has already asked for jump the queue.
+            int index = table->wanted.exchange(-1, std::memory_order_relaxed);
+
+            if (index < 0 || table->getLowPass(index) != nullptr)
+            {
+                while (next < numFrequencies && table->getLowPass(next) != nullptr)
+                    ++next;
+
+                index = next;
+            }
+
+            if (index >= numFrequencies)
+                break;
+
+            table->build(index);
+        }
+    }
+}
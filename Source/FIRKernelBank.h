@@ -0,0 +1,102 @@
+/*
+  ==============================================================================
+
+    FIRKernelBank.h
+
+    Process-wide cache of windowed-sinc low-pass kernels on a quantized
+    log-frequency grid. A band-pass kernel is the difference of two low-pass
+    kernels, so a note-on only needs two lookups and a subtraction.
+
+    Tables are created per (sample rate, tap count) from non-realtime code and
+    filled by a background thread. Each kernel is published with an atomic
+    pointer store, so readers on the audio thread never block; a lookup that
+    arrives before its kernel is ready returns nullptr.
+
+    Kernels long enough for FIRFilter to convolve them in partitions are
+    stored as the spectra of those partitions instead, so the filter can
+    switch cutoff with a subtraction rather than an FFT per partition. The
+    transform is linear, so the band-pass spectrum is the difference of the
+    two low-pass ones just as the kernel is.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+class FIRKernelBank : private juce::Thread
+{
+public:
+    static constexpr float minFrequency = 20.0f;
+    static constexpr int stepsPerOctave = 48;
+    static constexpr int numFrequencies = 480; // 20 Hz .. ~20.5 kHz
+
+    // FIRFilter's partitioning, which the stored spectra follow.
+    static constexpr int fftThresholdTaps = 256;
+    static constexpr int partitionSize = 128;
+    static constexpr int numBins = partitionSize + 1;
+
+    static bool isPartitioned(int numTaps) noexcept { return numTaps > fftThresholdTaps; }
+    static int getNumPartitions(int numTaps) noexcept { return (numTaps + partitionSize - 1) / partitionSize; }
+
+    class Table : public juce::ReferenceCountedObject
+    {
+    public:
+        using Ptr = juce::ReferenceCountedObjectPtr<Table>;
+
+        Table(double sampleRate, int numTaps);
+
+        const double sampleRate;
+        const int taps;
+        const bool partitioned;     // kernels are stored as partition spectra
+
+        // Low-pass kernel for a grid index, or nullptr if it hasn't been built
+        // yet. taps coefficients, or for a partitioned table the real parts
+        // of every partition's numBins bins followed by the imaginary parts
+        // (getKernelSize() floats in all).
+        const float* getLowPass(int index) const noexcept
+        {
+            return kernels[(size_t) index].load(std::memory_order_acquire);
+        }
+
+        int getKernelSize() const noexcept { return kernelSize; }
+
+        // Asks the builder to do this index next. Safe to call from the audio thread.
+        void request(int index) noexcept { wanted.store(index, std::memory_order_relaxed); }
+
+        bool isComplete() const noexcept { return numBuilt.load(std::memory_order_acquire) == numFrequencies; }
+
+    private:
+        friend class FIRKernelBank;
+
+        const int kernelSize;
+        std::vector<float> storage; // numFrequencies * kernelSize
+        std::array<std::atomic<const float*>, numFrequencies> kernels;
+        std::atomic<int> wanted{ -1 };
+        std::atomic<int> numBuilt{ 0 };
+
+        void build(int index);
+    };
+
+    FIRKernelBank();
+    ~FIRKernelBank() override;
+
+    // Returns the shared table for this configuration, creating it if needed.
+    // Allocates, so call it from prepareToPlay or the message thread.
+    Table::Ptr getTable(double sampleRate, int numTaps);
+
+    static int indexForFrequency(float hz) noexcept;
+    static float frequencyForIndex(int index) noexcept;
+
+private:
+    juce::CriticalSection lock;
+    juce::ReferenceCountedArray<Table> tables;
+
+    void run() override;
+    Table::Ptr findIncompleteTable();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FIRKernelBank)
+};
@@ -1,106 +1,400 @@
- #pragma once
+#pragma once
 #include <JuceHeader.h>
+#include <algorithm>
 #include <vector>
 #include <cmath>
+#include "SimdOps.h"
+#include "SimpleFFT.h"
+#include "FIRKernelBank.h"
+#include <type_traits>
 
+// Runs in float or double. Kernels come from the bank (or
+// generateCoefficients) in float and are widened once per setCutoff, so
+// all per-sample state and arithmetic stays in SampleType.
+//
+// setCutoff never designs a kernel: it runs on the audio thread. A cutoff
+// whose kernels the bank hasn't built yet is queued with the bank's
+// builder, and the filter keeps its current kernel until process() finds
+// the new one ready. Only the constructor designs one itself.
+template <typename SampleType>
 class FIRFilter
 {
 public:
+    using Complex = std::complex<SampleType>;
+
+    // Kernels longer than this are convolved in the frequency domain
+    // (uniformly partitioned overlap-save) instead of directly.
+    static constexpr int fftThresholdTaps = FIRKernelBank::fftThresholdTaps;
+    static constexpr int partitionSize = FIRKernelBank::partitionSize;
+
     FIRFilter() = default;
 
-    FIRFilter(int numTaps, double sampleRate)
+    // kernels must be the bank's table for this tap count and rate.
+    FIRFilter(int numTaps, double sampleRate, FIRKernelBank::Table::Ptr kernels)
         : taps(numTaps),
         fs(sampleRate),
-        buffer(numTaps, 0.0f),
-        coeffs(numTaps, 0.0f),
-		coeffsHighPass(numTaps, 0.0f)
+        partitioned(FIRKernelBank::isPartitioned(numTaps)),
+        kernelTable(std::move(kernels)),
+        coeffs((size_t) numTaps, SampleType(0))
     {
         jassert(numTaps >= 3);
-		tempBufferA.resize(numTaps, 0.0f);
-		tempBufferB.resize(numTaps, 0.0f);
-        setCutoff(cutoffLow, cutoffHigh); // default until user sets
+        jassert(kernelTable != nullptr && kernelTable->taps == numTaps && kernelTable->sampleRate == sampleRate);
+
+        if (partitioned)
+            preparePartitions();
+        else
+        {
+            reversedCoeffs.resize(numTaps, SampleType(0));
+            history.resize(2 * numTaps, SampleType(0));
+        }
+
+        // Not on the audio thread, so a kernel the bank hasn't got to yet
+        // can be designed here; the filter never starts without one.
+        setCutoff(cutoffLow, cutoffHigh);
+
+        if (pendingLow >= 0)
+            designKernel();
     }
 
-    void setCutoff(float cutoffHzLow, float cutoffHzHigh)
+    bool usesPartitionedConvolution() const noexcept { return partitioned; }
+
+    // The partitioned mode buffers one partition of input before it can produce output.
+    int getLatencySamples() const noexcept { return partitioned ? partitionSize : 0; }
+
+    // Moves the band to the bank's nearest grid frequencies. Never designs
+    // a kernel; see above.
+    void setCutoff(float cutoffHzLow, float cutoffHzHigh) noexcept
     {
         cutoffLow = cutoffHzLow;
 		cutoffHigh = cutoffHzHigh;
 
-		generateCoefficients(cutoffHzLow, tempBufferA);
-		generateCoefficients(cutoffHzHigh, tempBufferB);
+        const int lowIndex = FIRKernelBank::indexForFrequency(cutoffHzLow);
+        const int highIndex = FIRKernelBank::indexForFrequency(cutoffHzHigh);
 
-        for (int n = 0; n < taps; n++)
+        if (lowIndex == appliedLow && highIndex == appliedHigh)
         {
-			coeffs[n] = tempBufferB[n] - tempBufferA[n];
+            pendingLow = pendingHigh = -1;
+            return;
         }
+
+        pendingLow = lowIndex;
+        pendingHigh = highIndex;
+        applyPendingKernel();
     }
 
-    float processSample(float x) noexcept
+    // A cutoff is waiting for the bank to build its kernels.
+    bool isKernelPending() const noexcept { return pendingLow >= 0; }
+
+    // Forgets the input so far, keeping the kernel. Doesn't allocate.
+    void reset() noexcept
     {
-        buffer[index] = x;
+        std::fill(history.begin(), history.end(), SampleType(0));
+        index = 0;
 
-        float y = 0.0f;
-        int bufIdx = index;
+        std::fill(inputRe.begin(), inputRe.end(), SampleType(0));
+        std::fill(inputIm.begin(), inputIm.end(), SampleType(0));
+        std::fill(fftInput.begin(), fftInput.end(), SampleType(0));
+        std::fill(fftOutput.begin(), fftOutput.end(), SampleType(0));
+        newestSpectrum = 0;
+        fifoPosition = 0;
+    }
+
+    SampleType processSample(SampleType x) noexcept
+    {
+        if (partitioned)
+            return processPartitionedSample(x);
 
-        // low-pass
-        for (int i = 0; i < taps; i++)
+        // Every sample is written twice, taps apart, so the last `taps` inputs are
+        // always contiguous (oldest first) starting right after the write position.
+        history[index] = x;
+        history[index + taps] = x;
+
+        if (++index == taps)
+            index = 0;
+
+        return SimdOps::dotProduct(history.data() + index, reversedCoeffs.data(), taps);
+    }
+
+    // Filters n samples from in to out. in and out may point to the same buffer.
+    void process(const SampleType* in, SampleType* out, int n) noexcept
+    {
+        // A default-constructed filter stands in for one that isn't built;
+        // it should never be asked to filter, and passes audio through if it is.
+        jassert(kernelTable != nullptr);
+
+        if (kernelTable == nullptr)
         {
-            y += coeffs[i] * buffer[bufIdx];
-            bufIdx = (bufIdx == 0 ? taps - 1 : bufIdx - 1);
+            if (in != out)
+                std::copy(in, in + n, out);
+
+            return;
         }
 
-        index = (index + 1) % taps;
-        return y;
+        if (pendingLow >= 0)
+            applyPendingKernel();
+
+        if (partitioned)
+        {
+            for (int i = 0; i < n; i++)
+                out[i] = processPartitionedSample(in[i]);
+        }
+        else
+        {
+            for (int i = 0; i < n; i++)
+                out[i] = processSample(in[i]);
+        }
+    }
+
+    // Windowed-sinc low-pass kernel of numTaps coefficients.
+    static void generateCoefficients(float cutoffHz, double sampleRate, float* c, int numTaps)
+    {
+        const float fc = cutoffHz / sampleRate;  // normalized 0..0.5
+        const int M = numTaps - 1;
+
+        for (int n = 0; n < numTaps; n++)
+        {
+            int k = n - M / 2;
+
+            // Ideal sinc low-pass
+            float sinc = (k == 0)
+                ? 2.0f * fc
+                : std::sin(2.0f * juce::MathConstants<float>::pi * fc * k)
+                / (juce::MathConstants<float>::pi * k);
+
+            // Hamming window
+            float w = 0.53836 - 0.46164 * std::cos(2.0f * juce::MathConstants<float>::pi * n / M);
+
+            c[n] = sinc * w;
+        }
     }
 
-    void processBlock(juce::AudioBuffer<float>& bufferToProcess)
+    void processBlock(juce::AudioBuffer<SampleType>& bufferToProcess)
     {
         const int numSamples = bufferToProcess.getNumSamples();
         const int numChannels = bufferToProcess.getNumChannels();
 
         for (int ch = 0; ch < numChannels; ch++)
         {
-            float* data = bufferToProcess.getWritePointer(ch);
-
-            for (int i = 0; i < numSamples; i++)
-                data[i] = processSample(data[i]);
+            SampleType* data = bufferToProcess.getWritePointer(ch);
+            process(data, data, numSamples);
         }
     }
 
 private:
-    int taps;
-    double fs;
-    float cutoffLow = 20000.0f;
-	float cutoffHigh = 20.0f;
+    int taps = 0;
+    double fs = 44100.0;
+    bool partitioned = false;
+    FIRKernelBank::Table::Ptr kernelTable;
+    // The whole audible range until the first setCutoff.
+    float cutoffLow = 20.0f;
+    float cutoffHigh = 20000.0f;
 
-    std::vector<float> coeffs;
-	std::vector<float> coeffsHighPass;
-    std::vector<float> buffer;
+    // Grid indices of the kernel in use, and of one waiting for the bank.
+    int appliedLow = -1, appliedHigh = -1;
+    int pendingLow = -1, pendingHigh = -1;
 
-	std::vector<float> tempBufferA;
-    std::vector<float> tempBufferB;
+    std::vector<SampleType> coeffs;
+    std::vector<SampleType> reversedCoeffs; // coeffs in history order (oldest sample first)
+    std::vector<SampleType> history;        // 2 * taps, see processSample
 
     int index = 0;
 
-    void generateCoefficients(float cutoffHz, std::vector<float> & c)
+    // Partitioned convolution state. Spectra are stored split into real and
+    // imaginary arrays, (partitionSize + 1) bins per partition.
+    SimpleFFT<SampleType> fft;
+    int numPartitions = 0;
+    int numBins = 0;
+    std::vector<SampleType> kernelRe, kernelIm;   // H_p for every partition
+    std::vector<SampleType> inputRe, inputIm;     // frequency-domain delay line of input spectra
+    std::vector<SampleType> accRe, accIm;
+    std::vector<SampleType> fftInput;             // previous partition followed by the one being filled
+    std::vector<SampleType> fftOutput;            // last finished partition of output
+    std::vector<Complex> fftScratch;
+    int newestSpectrum = 0;
+    int fifoPosition = 0;
+
+    void preparePartitions()
+    {
+        const int fftSize = 2 * partitionSize;
+
+        fft = SimpleFFT<SampleType>(fftSize);
+        numPartitions = FIRKernelBank::getNumPartitions(taps);
+        numBins = FIRKernelBank::numBins;
+
+        kernelRe.assign(numPartitions * numBins, 0.0f);
+        kernelIm.assign(numPartitions * numBins, 0.0f);
+        inputRe.assign(numPartitions * numBins, 0.0f);
+        inputIm.assign(numPartitions * numBins, 0.0f);
+        accRe.assign(numBins, 0.0f);
+        accIm.assign(numBins, 0.0f);
+        fftInput.assign(fftSize, 0.0f);
+        fftOutput.assign(partitionSize, 0.0f);
+        fftScratch.assign(fftSize, {});
+    }
+
+    // Takes the pending band from the bank if both its kernels are built,
+    // or asks the builder for the first one missing.
+    void applyPendingKernel() noexcept
+    {
+        // A default-constructed filter has no table, so nothing to apply.
+        if (kernelTable == nullptr)
+        {
+            pendingLow = pendingHigh = -1;
+            return;
+        }
+
+        const float* lowKernel = kernelTable->getLowPass(pendingLow);
+        const float* highKernel = kernelTable->getLowPass(pendingHigh);
+
+        if (lowKernel == nullptr || highKernel == nullptr)
+        {
+            kernelTable->request(lowKernel == nullptr ? pendingLow : pendingHigh);
+            return;
+        }
+
+        // For a partitioned table these are spectra: real parts, then
+        // imaginary parts, laid out as kernelRe and kernelIm.
+        const int size = partitioned ? (int) kernelRe.size() : taps;
+        SampleType* re = partitioned ? kernelRe.data() : coeffs.data();
+
+        if constexpr (std::is_same_v<SampleType, float>)
+            juce::FloatVectorOperations::subtract(re, highKernel, lowKernel, size);
+        else
+            for (int n = 0; n < size; n++)
+                re[n] = (SampleType) highKernel[n] - (SampleType) lowKernel[n];
+
+        if (partitioned)
+        {
+            SampleType* im = kernelIm.data();
+
+            if constexpr (std::is_same_v<SampleType, float>)
+                juce::FloatVectorOperations::subtract(im, highKernel + size, lowKernel + size, size);
+            else
+                for (int n = 0; n < size; n++)
+                    im[n] = (SampleType) highKernel[size + n] - (SampleType) lowKernel[size + n];
+        }
+        else
+        {
+            std::copy(coeffs.rbegin(), coeffs.rend(), reversedCoeffs.begin());
+        }
+
+        appliedLow = pendingLow;
+        appliedHigh = pendingHigh;
+        pendingLow = pendingHigh = -1;
+    }
+
+    // Designs the pending band directly. Allocates and takes thousands of
+    // sin/cos calls, so only from the constructor.
+    void designKernel()
     {
-        const float fc = cutoffHz / fs;  // normalized 0..0.5
-        const int M = taps - 1;
+        std::vector<float> low((size_t) taps), high((size_t) taps);
+        generateCoefficients(juce::jmin(FIRKernelBank::frequencyForIndex(pendingLow), (float) (fs * 0.49)), fs, low.data(), taps);
+        generateCoefficients(juce::jmin(FIRKernelBank::frequencyForIndex(pendingHigh), (float) (fs * 0.49)), fs, high.data(), taps);
 
         for (int n = 0; n < taps; n++)
+            coeffs[n] = (SampleType) high[n] - (SampleType) low[n];
+
+        if (partitioned)
+            updateKernelSpectra();
+        else
+            std::copy(coeffs.rbegin(), coeffs.rend(), reversedCoeffs.begin());
+
+        appliedLow = pendingLow;
+        appliedHigh = pendingHigh;
+        pendingLow = pendingHigh = -1;
+    }
+
+    void updateKernelSpectra() noexcept
+    {
+        for (int p = 0; p < numPartitions; p++)
         {
-            int k = n - M / 2;
+            std::fill(fftScratch.begin(), fftScratch.end(), Complex());
 
-            // Ideal sinc low-pass
-            float sinc = (k == 0)
-                ? 2.0f * fc
-                : std::sin(2.0f * juce::MathConstants<float>::pi * fc * k)
-                / (juce::MathConstants<float>::pi * k);
+            for (int i = 0; i < partitionSize && p * partitionSize + i < taps; i++)
+                fftScratch[i] = coeffs[p * partitionSize + i];
 
-            // Hamming window
-            float w = 0.53836 - 0.46164 * std::cos(2.0f * juce::MathConstants<float>::pi * n / M);
+            fft.forward(fftScratch.data());
 
-            c[n] = sinc * w;
+            for (int k = 0; k < numBins; k++)
+            {
+                kernelRe[p * numBins + k] = fftScratch[k].real();
+                kernelIm[p * numBins + k] = fftScratch[k].imag();
+            }
+        }
+    }
+
+    SampleType processPartitionedSample(SampleType x) noexcept
+    {
+        const SampleType y = fftOutput[fifoPosition];
+        fftInput[partitionSize + fifoPosition] = x;
+
+        if (++fifoPosition == partitionSize)
+        {
+            fifoPosition = 0;
+            processPartition();
         }
+
+        return y;
+    }
+
+    void processPartition() noexcept
+    {
+        const int fftSize = 2 * partitionSize;
+
+        for (int i = 0; i < fftSize; i++)
+            fftScratch[i] = fftInput[i];
+
+        fft.forward(fftScratch.data());
+
+        newestSpectrum = (newestSpectrum == 0 ? numPartitions - 1 : newestSpectrum - 1);
+
+        SampleType* newRe = inputRe.data() + newestSpectrum * numBins;
+        SampleType* newIm = inputIm.data() + newestSpectrum * numBins;
+
+        for (int k = 0; k < numBins; k++)
+        {
+            newRe[k] = fftScratch[k].real();
+            newIm[k] = fftScratch[k].imag();
+        }
+
+        std::fill(accRe.begin(), accRe.end(), SampleType(0));
+        std::fill(accIm.begin(), accIm.end(), SampleType(0));
+
+        // Y = sum over p of X[block - p] * H[p]
+        int slot = newestSpectrum;
+
+        for (int p = 0; p < numPartitions; p++)
+        {
+            const SampleType* xr = inputRe.data() + slot * numBins;
+            const SampleType* xi = inputIm.data() + slot * numBins;
+            const SampleType* hr = kernelRe.data() + p * numBins;
+            const SampleType* hi = kernelIm.data() + p * numBins;
+
+            for (int k = 0; k < numBins; k++)
+            {
+                accRe[k] += xr[k] * hr[k] - xi[k] * hi[k];
+                accIm[k] += xr[k] * hi[k] + xi[k] * hr[k];
+            }
+
+            if (++slot == numPartitions)
+                slot = 0;
+        }
+
+        // Real input, so the upper half of the spectrum is the conjugate mirror.
+        for (int k = 0; k < numBins; k++)
+            fftScratch[k] = Complex(accRe[k], accIm[k]);
+
+        for (int k = 1; k < partitionSize; k++)
+            fftScratch[fftSize - k] = std::conj(fftScratch[k]);
+
+        fft.inverse(fftScratch.data());
+
+        // Overlap-save: only the second half is free of circular wraparound.
+        const SampleType scale = SampleType(1) / (SampleType) fftSize;
+
+        for (int i = 0; i < partitionSize; i++)
+            fftOutput[i] = fftScratch[partitionSize + i].real() * scale;
+
+        std::copy(fftInput.begin() + partitionSize, fftInput.end(), fftInput.begin());
     }
 };
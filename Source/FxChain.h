@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    FxChain.h
+
+    The order of the effects run on the summed output, as a value. A chain
+    is never changed in place: withInserted, withRemoved and withMoved
+    return a new one, which the UI hands to the processor. The whole chain
+    fits in eight bytes, so FxStage publishes it through a lock-free
+    std::atomic and the audio thread picks it up whole at the start of a
+    block; there is no old chain to free and nothing for either side to
+    wait on.
+
+    Each effect appears at most once, as there is one of each per processor.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+
+class alignas(8) FxChain
+{
+public:
+    enum class Effects : juce::uint8
+    {
+        chorus = 0,
+        flanger,
+        delay,
+        dcBlocker
+    };
+
+    static constexpr int numEffects = 4;
+
+    FxChain() = default;
+
+    int size() const noexcept { return length; }
+    bool isEmpty() const noexcept { return length == 0; }
+    Effects operator[] (int index) const noexcept { return slots[(size_t) index]; }
+
+    int indexOf(Effects effect) const noexcept
+    {
+        for (int i = 0; i < length; ++i)
+            if (slots[(size_t) i] == effect)
+                return i;
+
+        return -1;
+    }
+
+    bool contains(Effects effect) const noexcept { return indexOf(effect) >= 0; }
+
+    // Inserts before index (clamped to the chain); an effect that is already
+    // in the chain is moved there instead.
+    FxChain withInserted(int index, Effects effect) const noexcept
+    {
+        FxChain c = withRemoved(indexOf(effect));
+        index = juce::jlimit(0, (int) c.length, index);
+
+        for (int i = c.length; i > index; --i)
+            c.slots[(size_t) i] = c.slots[(size_t) i - 1];
+
+        c.slots[(size_t) index] = effect;
+        ++c.length;
+        return c;
+    }
+
+    // An index outside the chain returns it unchanged.
+    FxChain withRemoved(int index) const noexcept
+    {
+        FxChain c = *this;
+
+        if (!juce::isPositiveAndBelow(index, (int) length))
+            return c;
+
+        for (int i = index; i < length - 1; ++i)
+            c.slots[(size_t) i] = c.slots[(size_t) i + 1];
+
+        --c.length;
+        return c;
+    }
+
+    FxChain withMoved(int from, int to) const noexcept
+    {
+        if (!juce::isPositiveAndBelow(from, (int) length))
+            return *this;
+
+        return withRemoved(from).withInserted(to, slots[(size_t) from]);
+    }
+
+    bool operator== (const FxChain& other) const noexcept
+    {
+        if (length != other.length)
+            return false;
+
+        for (int i = 0; i < length; ++i)
+            if (slots[(size_t) i] != other.slots[(size_t) i])
+                return false;
+
+        return true;
+    }
+
+    bool operator!= (const FxChain& other) const noexcept { return ! operator== (other); }
+
+    // For the plugin state: effect names in order, e.g. "chorus,delay".
+    juce::String toString() const
+    {
+        juce::StringArray names;
+
+        for (int i = 0; i < length; ++i)
+            names.add(getName(slots[(size_t) i]));
+
+        return names.joinIntoString(",");
+    }
+
+    // Unknown names are skipped.
+    static FxChain fromString(const juce::String& text)
+    {
+        FxChain c;
+
+        for (auto& name : juce::StringArray::fromTokens(text, ",", {}))
+            for (int e = 0; e < numEffects; ++e)
+                if (name.trim() == getName((Effects) e))
+                    c = c.withInserted(c.size(), (Effects) e);
+
+        return c;
+    }
+
+    static const char* getName(Effects effect) noexcept
+    {
+        switch (effect)
+        {
+            case Effects::chorus:    return "chorus";
+            case Effects::flanger:   return "flanger";
+            case Effects::delay:     return "delay";
+            case Effects::dcBlocker: return "dcBlocker";
+        }
+
+        return "";
+    }
+
+private:
+    std::array<Effects, numEffects> slots{};
+    juce::uint8 length = 0;
+};
+
+static_assert(sizeof(FxChain) == 8, "FxChain has to fit a lock-free atomic");
@@ -0,0 +1,172 @@
+/*
+  ==============================================================================
+
+    FxStage.cpp
+
+  ==============================================================================
+*/
+
+#include "FxStage.h"
+
+void FxStage::reserveDelayLines(DelayLineArena& arena, const DspContext& context)
+{
+    using Modulated = FxUnits::ModulatedDelay<float>;
+
+    for (int ch = 0; ch < FxUnits::maxChannels; ++ch)
+    {
+        slots[(size_t) (chorusSlot + ch)] = arena.reserve(Modulated::getMaximumDelaySamples(Modulated::chorus, context));
+        slots[(size_t) (flangerSlot + ch)] = arena.reserve(Modulated::getMaximumDelaySamples(Modulated::flanger, context));
+        slots[(size_t) (delaySlot + ch)] = arena.reserve(FxUnits::FeedbackDelay<float>::getMaximumDelaySamples(context));
+    }
+}
+
+void FxStage::prepare(DelayLineArena& arena, const DspContext& context)
+{
+    samplesPerMs = context.millisecondsToSamples(1.0);
+
+    if (context.doublePrecision)
+    {
+        prepareUnits<double>(arena, context);
+        floatUnits.scratch.setSize(0, 0);
+    }
+    else
+    {
+        prepareUnits<float>(arena, context);
+        doubleUnits.scratch.setSize(0, 0);
+    }
+
+    // A prepared stage starts from silence, so the chain can be taken as is.
+    chain = getChain();
+}
+
+template <typename SampleType>
+void FxStage::prepareUnits(DelayLineArena& arena, const DspContext& context)
+{
+    auto& units = getUnits<SampleType>();
+
+    auto linesFrom = [&](int first)
+    {
+        std::array<DelayLine<SampleType>, FxUnits::maxChannels> lines;
+
+        for (int ch = 0; ch < FxUnits::maxChannels; ++ch)
+            lines[(size_t) ch] = arena.getLine<SampleType>(slots[(size_t) (first + ch)]);
+
+        return lines;
+    };
+
+    units.chorus.prepare(context, linesFrom(chorusSlot));
+    units.flanger.prepare(context, linesFrom(flangerSlot));
+    units.delay.prepare(context, linesFrom(delaySlot));
+    units.dcBlocker.prepare(context);
+    units.scratch.setSize(2, context.maximumBlockSize);
+}
+
+template <typename SampleType>
+void FxStage::Units<SampleType>::reset(FxChain::Effects effect) noexcept
+{
+    switch (effect)
+    {
+        case FxChain::Effects::chorus:    chorus.reset(); break;
+        case FxChain::Effects::flanger:   flanger.reset(); break;
+        case FxChain::Effects::delay:     delay.reset(); break;
+        case FxChain::Effects::dcBlocker: dcBlocker.reset(); break;
+    }
+}
+
+template <typename SampleType>
+void FxStage::process(juce::AudioBuffer<SampleType>& buffer, const ParameterSnapshot::FxSettings& settings) noexcept
+{
+    // Block boundary: adopt the latest chain, clearing effects that join it.
+    const FxChain next = pendingChain.load(std::memory_order_acquire);
+    auto& units = getUnits<SampleType>();
+
+    if (next != chain)
+    {
+        for (int i = 0; i < next.size(); ++i)
+            if (!chain.contains(next[i]))
+                units.reset(next[i]);
+
+        chain = next;
+    }
+
+    tailSamples.store(computeTailSamples(settings), std::memory_order_relaxed);
+
+    if (chain.isEmpty())
+        return;
+
+    // Longer host blocks than prepareToPlay promised go through in pieces.
+    const int numChannels = juce::jmin(buffer.getNumChannels(), FxUnits::maxChannels);
+    const int maxBlock = units.scratch.getNumSamples();
+
+    for (int start = 0; start < buffer.getNumSamples(); start += maxBlock)
+    {
+        const int count = juce::jmin(maxBlock, buffer.getNumSamples() - start);
+        auto piece = settings;
+        piece.delayTime.start = settings.delayTime.at(start);
+
+        for (int e = 0; e < chain.size(); ++e)
+            for (int ch = 0; ch < numChannels; ++ch)
+                processEffect(units, chain[e], buffer.getWritePointer(ch, start), ch, count, piece);
+    }
+}
+
+template <typename SampleType>
+void FxStage::processEffect(Units<SampleType>& units, FxChain::Effects effect, SampleType* data, int channel,
+                            int numSamples, const ParameterSnapshot::FxSettings& s) noexcept
+{
+    SampleType* wet = units.scratch.getWritePointer(0);
+    SampleType* delays = units.scratch.getWritePointer(1);
+
+    switch (effect)
+    {
+        case FxChain::Effects::chorus:
+            units.chorus.process(data, channel, numSamples, s.chorusRate, s.chorusDepth, 0.0f, s.chorusMix, wet, delays);
+            break;
+
+        case FxChain::Effects::flanger:
+            units.flanger.process(data, channel, numSamples, s.flangerRate, s.flangerDepth, s.flangerFeedback,
+                                  s.flangerMix, wet, delays);
+            break;
+
+        case FxChain::Effects::delay:
+            units.delay.process(data, channel, numSamples, s.delayTime, s.delayFeedback, s.delayMix, wet, delays);
+            break;
+
+        case FxChain::Effects::dcBlocker:
+            units.dcBlocker.process(data, channel, numSamples);
+            break;
+    }
+}
+
+int FxStage::computeTailSamples(const ParameterSnapshot::FxSettings& s) const noexcept
+{
+    using Modulated = FxUnits::ModulatedDelay<float>;
+    double tail = 0.0;
+
+    // The effects run in series, so their tails add up.
+    for (int i = 0; i < chain.size(); ++i)
+    {
+        switch (chain[i])
+        {
+            case FxChain::Effects::chorus:
+                tail += Modulated::getTailSamples(Modulated::chorus, samplesPerMs, 0.0f);
+                break;
+
+            case FxChain::Effects::flanger:
+                tail += Modulated::getTailSamples(Modulated::flanger, samplesPerMs, s.flangerFeedback);
+                break;
+
+            case FxChain::Effects::delay:
+                tail += FxUnits::FeedbackDelay<float>::getTailSamples(samplesPerMs, s.delayTime.start, s.delayFeedback);
+                break;
+
+            case FxChain::Effects::dcBlocker:
+                break;
+        }
+    }
+
+    return (int) std::ceil(tail);
+}
+
+template void FxStage::process<float>(juce::AudioBuffer<float>&, const ParameterSnapshot::FxSettings&) noexcept;
+template void FxStage::process<double>(juce::AudioBuffer<double>&, const ParameterSnapshot::FxSettings&) noexcept;
@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    FxStage.h
+
+    The effects after the synth: one of each FxUnits effect, run on the
+    summed output in the order of the current FxChain.
+
+    The UI changes the order by building a new FxChain and calling
+    setChain() from any thread. The chain is stored in a lock-free atomic,
+    and process() loads it once at the start of each block, so a block
+    runs entirely under the old chain or entirely under the new one. An
+    effect that joins the chain starts from silence instead of replaying
+    whatever its delay lines held when it was last used. Nothing is
+    allocated or locked on the audio thread: every unit and its delay
+    lines are set up in prepare(), whether it is in the chain or not.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "FxChain.h"
+#include "FxUnits.h"
+#include "DelayLineArena.h"
+#include "DspContext.h"
+#include "ParameterSnapshot.h"
+#include <atomic>
+#include <type_traits>
+
+class FxStage
+{
+public:
+    FxStage() = default;
+
+    // Any thread; takes effect at the next block.
+    void setChain(const FxChain& newChain) noexcept { pendingChain.store(newChain, std::memory_order_release); }
+    FxChain getChain() const noexcept { return pendingChain.load(std::memory_order_acquire); }
+
+    // prepareToPlay: reserve before the arena allocates, prepare after.
+    void reserveDelayLines(DelayLineArena& arena, const DspContext& context);
+    void prepare(DelayLineArena& arena, const DspContext& context);
+
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer, const ParameterSnapshot::FxSettings& settings) noexcept;
+
+    // How long the chain rings after its input stops, at the settings of
+    // the last block it processed. Any thread.
+    int getTailSamples() const noexcept { return tailSamples.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<FxChain> pendingChain{ FxChain() };
+    FxChain chain;  // the audio thread's copy
+    double samplesPerMs = 44.1;
+    std::atomic<int> tailSamples{ 0 };
+
+    static_assert(std::atomic<FxChain>::is_always_lock_free, "FxChain must be swapped without a lock");
+
+    // DelayLineArena slots: chorus, flanger and echo, per channel.
+    enum DelaySlots { chorusSlot = 0, flangerSlot = FxUnits::maxChannels, delaySlot = 2 * FxUnits::maxChannels };
+    std::array<int, 3 * FxUnits::maxChannels> slots{};
+
+    template <typename SampleType>
+    struct Units
+    {
+        FxUnits::ModulatedDelay<SampleType> chorus{ FxUnits::ModulatedDelay<SampleType>::chorus };
+        FxUnits::ModulatedDelay<SampleType> flanger{ FxUnits::ModulatedDelay<SampleType>::flanger };
+        FxUnits::FeedbackDelay<SampleType> delay;
+        FxUnits::DcBlocker<SampleType> dcBlocker;
+
+        juce::AudioBuffer<SampleType> scratch; // wet, delays
+
+        void reset(FxChain::Effects effect) noexcept;
+    };
+
+    // Only the precision the host renders in is prepared.
+    Units<float> floatUnits;
+    Units<double> doubleUnits;
+
+    template <typename SampleType>
+    Units<SampleType>& getUnits() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleUnits;
+        else
+            return floatUnits;
+    }
+
+    template <typename SampleType>
+    void prepareUnits(DelayLineArena& arena, const DspContext& context);
+
+    int computeTailSamples(const ParameterSnapshot::FxSettings& settings) const noexcept;
+
+    template <typename SampleType>
+    void processEffect(Units<SampleType>& units, FxChain::Effects effect, SampleType* data, int channel,
+                       int numSamples, const ParameterSnapshot::FxSettings& settings) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE(FxStage)
+};
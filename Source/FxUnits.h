@@ -0,0 +1,283 @@
+/*
+  ==============================================================================
+
+    FxUnits.h
+
+    The effects FxStage runs on the summed output, each processing a whole
+    block of one channel at a time on DelayLineArena lines:
+
+      ModulatedDelay  chorus and flanger: an LFO sweeps a short delay,
+                      read with Lagrange interpolation, with feedback
+      FeedbackDelay   echo of up to maximumDelayMs, with feedback
+      DcBlocker       one-pole high-pass at 10 Hz
+
+    The delays all go through feedbackComb(). A feedback loop can't simply
+    read a block and write a block, since the block may be longer than the
+    delay; but every read of a run shorter than the smallest delay in it
+    only touches samples that are already written. So the block is cut into
+    such runs, and each run is a block read (independent iterations), one
+    vector loop adding the feedback, and a block write. At the chorus's and
+    echo's delays that is one run per block; the flanger's shortest delay,
+    1 ms, gives runs of about 44 samples.
+
+    The DC blocker's recursion runs sample by sample; it is three
+    operations per sample.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "DelayLine.h"
+#include "ControlRateLfo.h"
+#include "DspContext.h"
+#include "ParameterSnapshot.h"
+#include <array>
+#include <cmath>
+
+namespace FxUnits
+{
+    static constexpr int maxChannels = 2;
+
+    // Feedback is clamped below this so no setting can make a loop unstable.
+    static constexpr float maximumFeedback = 0.95f;
+
+    // dry + mix * (wet - dry), in place.
+    template <typename SampleType>
+    void mixInto(SampleType* dry, const SampleType* wet, SampleType mix, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dry[i] += mix * (wet[i] - dry[i]);
+    }
+
+    // wet[i] is the line delays[i] samples before input i (fractional), and
+    // the line is fed in[i] + feedback * wet[i]. delays is overwritten.
+    template <typename SampleType>
+    void feedbackComb(DelayLine<SampleType>& line, const SampleType* in, SampleType* wet, SampleType* delays,
+                      int numSamples, SampleType feedback) noexcept
+    {
+        // The Lagrange read at delay d reaches floor(d) - 1 samples back at
+        // the nearest, so a run that long reads only what has been written.
+        const auto shortest = juce::FloatVectorOperations::findMinimum(delays, numSamples);
+        const int runLength = juce::jmax(1, (int) shortest - 1);
+
+        for (int i = 0; i < numSamples; i += runLength)
+        {
+            const int count = juce::jmin(runLength, numSamples - i);
+            SampleType* feed = delays + i;
+
+            line.readLagrange(wet + i, delays + i, count);
+
+            for (int k = 0; k < count; ++k)
+                feed[k] = in[i + k] + feedback * wet[i + k];
+
+            line.write(feed, count);
+        }
+    }
+
+    // The same with a whole-sample delay: plain block reads, no interpolation.
+    template <typename SampleType>
+    void feedbackComb(DelayLine<SampleType>& line, const SampleType* in, SampleType* wet, SampleType* scratch,
+                      int delay, int numSamples, SampleType feedback) noexcept
+    {
+        for (int i = 0; i < numSamples; i += delay)
+        {
+            const int count = juce::jmin(delay, numSamples - i);
+
+            line.read(wet + i, delay, count);
+
+            for (int k = 0; k < count; ++k)
+                scratch[k] = in[i + k] + feedback * wet[i + k];
+
+            line.write(scratch, count);
+        }
+    }
+
+    // Samples for feedback to fall to -80 dB, starting from one delay.
+    inline double ringSamples(double delaySamples, float feedback) noexcept
+    {
+        const double g = juce::jlimit(0.0, (double) maximumFeedback, std::abs((double) feedback));
+
+        if (g < 1.0e-4)
+            return delaySamples;
+
+        return delaySamples * (1.0 + std::log(1.0e-4) / std::log(g));
+    }
+
+    //==============================================================================
+    template <typename SampleType>
+    class ModulatedDelay
+    {
+    public:
+        struct Shape
+        {
+            WaveFormSettings::WaveForms wave;
+            double centreMs;       // delay at the middle of the sweep
+            double sweepMs;        // either side of the centre at depth 1
+            double channelPhase;   // LFO offset of each channel after the first, in cycles
+        };
+
+        static constexpr Shape chorus{ WaveFormSettings::WaveForms::sine, 15.0, 5.0, 0.25 };
+        static constexpr Shape flanger{ WaveFormSettings::WaveForms::triangle, 4.0, 3.0, 0.0 };
+
+        explicit ModulatedDelay(const Shape& s) noexcept : shape(s) {}
+
+        static int getMaximumDelaySamples(const Shape& s, const DspContext& context) noexcept
+        {
+            return (int) std::ceil(context.millisecondsToSamples(s.centreMs + s.sweepMs)) + 1;
+        }
+
+        static double getTailSamples(const Shape& s, double samplesPerMs, float feedback) noexcept
+        {
+            return ringSamples(samplesPerMs * (s.centreMs + s.sweepMs), feedback);
+        }
+
+        void prepare(const DspContext& context, const std::array<DelayLine<SampleType>, maxChannels>& newLines) noexcept
+        {
+            lines = newLines;
+            samplesPerMs = context.millisecondsToSamples(1.0);
+
+            for (auto& lfo : lfos)
+                lfo.prepare(context);
+
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            for (size_t ch = 0; ch < lines.size(); ++ch)
+            {
+                lines[ch].reset();
+                lfos[ch].reset(shape.channelPhase * (double) ch);
+            }
+        }
+
+        // wet and delays are scratch of numSamples each.
+        void process(SampleType* data, int channel, int numSamples, float rate, float depth, float feedback,
+                     float mix, SampleType* wet, SampleType* delays) noexcept
+        {
+            const double centre = shape.centreMs * samplesPerMs;
+            const double sweep = juce::jlimit(0.0f, 1.0f, depth) * shape.sweepMs * samplesPerMs;
+
+            lfos[(size_t) channel].render(delays, numSamples, shape.wave, ParameterSnapshot::Ramp{ rate, 0.0f },
+                                          [centre, sweep](int, double wave) { return centre + sweep * wave; });
+
+            feedbackComb(lines[(size_t) channel], data, wet, delays, numSamples,
+                         (SampleType) juce::jlimit(-maximumFeedback, maximumFeedback, feedback));
+
+            mixInto(data, wet, (SampleType) mix, numSamples);
+        }
+
+    private:
+        Shape shape;
+        double samplesPerMs = 44.1;
+        std::array<DelayLine<SampleType>, maxChannels> lines;
+        std::array<ControlRateLfo, maxChannels> lfos;
+    };
+
+    //==============================================================================
+    template <typename SampleType>
+    class FeedbackDelay
+    {
+    public:
+        static constexpr double minimumDelayMs = 1.0;
+        static constexpr double maximumDelayMs = 2000.0;   // the "delayTime" range
+
+        static int getMaximumDelaySamples(const DspContext& context) noexcept
+        {
+            return (int) std::ceil(context.millisecondsToSamples(maximumDelayMs)) + 1;
+        }
+
+        static double getTailSamples(double samplesPerMs, float timeMs, float feedback) noexcept
+        {
+            return ringSamples(samplesPerMs * juce::jlimit(minimumDelayMs, maximumDelayMs, (double) timeMs), feedback);
+        }
+
+        void prepare(const DspContext& context, const std::array<DelayLine<SampleType>, maxChannels>& newLines) noexcept
+        {
+            lines = newLines;
+            samplesPerMs = context.millisecondsToSamples(1.0);
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            for (auto& line : lines)
+                line.reset();
+        }
+
+        // While the time is being smoothed the delay glides, read with
+        // interpolation; a settled time is a whole number of samples.
+        void process(SampleType* data, int channel, int numSamples, const ParameterSnapshot::Ramp& timeMs,
+                     float feedback, float mix, SampleType* wet, SampleType* delays) noexcept
+        {
+            auto& line = lines[(size_t) channel];
+            const auto fb = (SampleType) juce::jlimit(0.0f, maximumFeedback, feedback);
+
+            if (timeMs.isSmoothing())
+            {
+                const auto start = (SampleType) (timeMs.start * samplesPerMs);
+                const auto step = (SampleType) (timeMs.step * samplesPerMs);
+                const auto lowest = (SampleType) (minimumDelayMs * samplesPerMs);
+                const auto highest = (SampleType) (maximumDelayMs * samplesPerMs);
+
+                for (int i = 0; i < numSamples; ++i)
+                    delays[i] = juce::jlimit(lowest, highest, start + step * (SampleType) i);
+
+                feedbackComb(line, data, wet, delays, numSamples, fb);
+            }
+            else
+            {
+                const double ms = juce::jlimit(minimumDelayMs, maximumDelayMs, (double) timeMs.start);
+                feedbackComb(line, data, wet, delays, juce::jmax(1, juce::roundToInt(ms * samplesPerMs)), numSamples, fb);
+            }
+
+            mixInto(data, wet, (SampleType) mix, numSamples);
+        }
+
+    private:
+        double samplesPerMs = 44.1;
+        std::array<DelayLine<SampleType>, maxChannels> lines;
+    };
+
+    //==============================================================================
+    template <typename SampleType>
+    class DcBlocker
+    {
+    public:
+        static constexpr double cutoffHz = 10.0;
+
+        void prepare(const DspContext& context) noexcept
+        {
+            pole = (SampleType) std::exp(-juce::MathConstants<double>::twoPi * cutoffHz * context.inverseSampleRate);
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            lastInput.fill(0);
+            lastOutput.fill(0);
+        }
+
+        void process(SampleType* data, int channel, int numSamples) noexcept
+        {
+            SampleType x1 = lastInput[(size_t) channel];
+            SampleType y1 = lastOutput[(size_t) channel];
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const SampleType x = data[i];
+                y1 = x - x1 + pole * y1;
+                x1 = x;
+                data[i] = y1;
+            }
+
+            lastInput[(size_t) channel] = x1;
+            lastOutput[(size_t) channel] = y1;
+        }
+
+    private:
+        SampleType pole = SampleType(0.999);
+        std::array<SampleType, maxChannels> lastInput{}, lastOutput{};
+    };
+}
@@ -0,0 +1,182 @@
+/*
+  ==============================================================================
+
+    IIRBandFilter.h
+
+    The cheap alternative to FIRFilter: the same cutoffLow - cutoffHigh band,
+    built from two second-order sections, a high-pass at the low edge and a
+    low-pass at the high edge, both Butterworth. The patch picks the section
+    type:
+
+      stateVariable  trapezoidal (TPT) state-variable filter; stays well
+                     behaved when the cutoff moves every sub-block
+      biquad         RBJ cookbook biquads in transposed direct form II
+
+    A sample costs about ten multiply-adds whatever the cutoff, and a new
+    cutoff is two tan() or sin/cos calls, so modulated cutoffs are simply
+    recomputed. There is no latency.
+
+    tick() works on one section given a pointer to its coefficients and a
+    stride between them. The filter itself uses stride 1; VoiceBank keeps
+    the coefficients and states of many voices structure-of-arrays and calls
+    it with its lane count as the stride, so the same code filters a whole
+    SIMD register of voices per step.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "WaveFormSettings.h"
+#include <array>
+#include <cmath>
+
+template <typename SampleType>
+class IIRBandFilter
+{
+public:
+    using Engine = WaveFormSettings::FilterEngines;
+
+    static constexpr int numSections = 2;      // high-pass, then low-pass
+    static constexpr int numCoefficients = 6;
+    static constexpr int numStates = 2;
+
+    // A 20 Hz high-pass section has died away by more than 120 dB after this.
+    static constexpr double tailSeconds = 0.2;
+
+    // stateVariable: a1, a2, a3 and the output mix m0 (input), m1 (band), m2 (low).
+    // biquad: b0, b1, b2, a1, a2, normalised by a0; the last one is unused.
+    using Coefficients = std::array<SampleType, numCoefficients>;
+    using State = std::array<SampleType, numStates>;
+
+    IIRBandFilter() = default;
+
+    IIRBandFilter(double sampleRate, Engine sectionType)
+        : fs(sampleRate), engine(sectionType)
+    {
+        jassert(engine != Engine::fir);
+        setCutoff(cutoffLow, cutoffHigh);
+    }
+
+    Engine getEngine() const noexcept { return engine; }
+    int getLatencySamples() const noexcept { return 0; }
+
+    void setCutoff(float cutoffHzLow, float cutoffHzHigh) noexcept
+    {
+        cutoffLow = cutoffHzLow;
+        cutoffHigh = cutoffHzHigh;
+
+        if (engine == Engine::biquad)
+        {
+            coefficients[0] = biquadSection(cutoffHzLow, true);
+            coefficients[1] = biquadSection(cutoffHzHigh, false);
+        }
+        else
+        {
+            coefficients[0] = stateVariableSection(cutoffHzLow, true);
+            coefficients[1] = stateVariableSection(cutoffHzHigh, false);
+        }
+    }
+
+    void reset() noexcept
+    {
+        for (auto& s : states)
+            s.fill(SampleType(0));
+    }
+
+    // out may alias in.
+    void process(const SampleType* in, SampleType* out, int n) noexcept
+    {
+        if (engine == Engine::biquad)
+            processSections<Engine::biquad>(in, out, n);
+        else
+            processSections<Engine::stateVariable>(in, out, n);
+    }
+
+    // Section data, for VoiceBank to copy into and back out of its lanes.
+    const Coefficients& getCoefficients(int section) const noexcept { return coefficients[(size_t) section]; }
+    State& getState(int section) noexcept { return states[(size_t) section]; }
+
+    // One sample through one section. c[k * stride] is coefficient k.
+    template <Engine sectionType, int stride = 1>
+    static SampleType tick(const SampleType* c, SampleType& s1, SampleType& s2, SampleType x) noexcept
+    {
+        if constexpr (sectionType == Engine::biquad)
+        {
+            const SampleType y = c[0] * x + s1;
+            s1 = c[stride] * x - c[3 * stride] * y + s2;
+            s2 = c[2 * stride] * x - c[4 * stride] * y;
+            return y;
+        }
+        else
+        {
+            const SampleType v3 = x - s2;
+            const SampleType v1 = c[0] * s1 + c[stride] * v3;
+            const SampleType v2 = s2 + c[stride] * s1 + c[2 * stride] * v3;
+            s1 = SampleType(2) * v1 - s1;
+            s2 = SampleType(2) * v2 - s2;
+            return c[3 * stride] * x + c[4 * stride] * v1 + c[5 * stride] * v2;
+        }
+    }
+
+private:
+    double fs = 44100.0;
+    Engine engine = Engine::stateVariable;
+    float cutoffLow = 20.0f;
+    float cutoffHigh = 20000.0f;
+
+    std::array<Coefficients, numSections> coefficients{};
+    std::array<State, numSections> states{};
+
+    template <Engine sectionType>
+    void processSections(const SampleType* in, SampleType* out, int n) noexcept
+    {
+        // The state lives in locals for the block so it stays in registers.
+        auto s = states;
+
+        for (int i = 0; i < n; ++i)
+        {
+            SampleType x = in[i];
+
+            for (size_t k = 0; k < (size_t) numSections; ++k)
+                x = tick<sectionType>(coefficients[k].data(), s[k][0], s[k][1], x);
+
+            out[i] = x;
+        }
+
+        states = s;
+    }
+
+    // Keeps the sections stable and clear of Nyquist at any rate.
+    double normalisedCutoff(float hz) const noexcept
+    {
+        return juce::jlimit(1.0, 0.49 * fs, (double) hz) / fs;
+    }
+
+    Coefficients stateVariableSection(float hz, bool highPass) const noexcept
+    {
+        const double k = juce::MathConstants<double>::sqrt2; // 1 / Q
+        const double g = std::tan(juce::MathConstants<double>::pi * normalisedCutoff(hz));
+        const double a1 = 1.0 / (1.0 + g * (g + k));
+        const double a2 = g * a1;
+        const double a3 = g * a2;
+
+        if (highPass)
+            return { (SampleType) a1, (SampleType) a2, (SampleType) a3, SampleType(1), (SampleType) -k, SampleType(-1) };
+
+        return { (SampleType) a1, (SampleType) a2, (SampleType) a3, SampleType(0), SampleType(0), SampleType(1) };
+    }
+
+    Coefficients biquadSection(float hz, bool highPass) const noexcept
+    {
+        const double w0 = juce::MathConstants<double>::twoPi * normalisedCutoff(hz);
+        const double cosw = std::cos(w0);
+        const double alpha = std::sin(w0) / juce::MathConstants<double>::sqrt2; // sin / (2Q)
+        const double a0 = 1.0 + alpha;
+        const double b1 = highPass ? -(1.0 + cosw) : 1.0 - cosw;
+        const double b0 = (highPass ? 1.0 + cosw : 1.0 - cosw) * 0.5;
+
+        return { (SampleType) (b0 / a0), (SampleType) (b1 / a0), (SampleType) (b0 / a0),
+                 (SampleType) (-2.0 * cosw / a0), (SampleType) ((1.0 - alpha) / a0), SampleType(0) };
+    }
+};
@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+    MappedSample.cpp
+
+  ==============================================================================
+*/
+
+#include "MappedSample.h"
+#include <cstring>
+
+namespace
+{
+    constexpr int pcmFormat = 1;
+    constexpr int extensibleFormat = 0xfffe;
+
+    bool hasId(const char* chunk, const char* id) noexcept
+    {
+        return std::memcmp(chunk, id, 4) == 0;
+    }
+}
+
+MappedSample::MappedSample(const juce::File& source, std::unique_ptr<juce::MemoryMappedFile> map)
+    : file(source), mapping(std::move(map)) {}
+
+MappedSample::Ptr MappedSample::open(const juce::File& file)
+{
+    auto map = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    const auto* data = static_cast<const char*>(map->getData());
+    const auto size = (juce::int64) map->getSize();
+
+    if (data == nullptr || size < 12 || !hasId(data, "RIFF") || !hasId(data + 8, "WAVE"))
+        return nullptr;
+
+    int format = 0, channels = 0, blockAlign = 0, bits = 0;
+    double rate = 0.0;
+    const char* dataChunk = nullptr;
+    juce::int64 dataSize = 0;
+
+    // Chunks are word-aligned; anything but "fmt " and "data" is skipped.
+    for (juce::int64 pos = 12; pos + 8 <= size;)
+    {
+        const char* chunk = data + pos;
+        const auto chunkSize = (juce::int64) juce::ByteOrder::littleEndianInt(chunk + 4);
+        const char* body = chunk + 8;
+
+        if (hasId(chunk, "fmt ") && chunkSize >= 16 && pos + 8 + chunkSize <= size)
+        {
+            format = juce::ByteOrder::littleEndianShort(body);
+            channels = juce::ByteOrder::littleEndianShort(body + 2);
+            rate = (double) juce::ByteOrder::littleEndianInt(body + 4);
+            blockAlign = juce::ByteOrder::littleEndianShort(body + 12);
+            bits = juce::ByteOrder::littleEndianShort(body + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE names the real format in its sub-format GUID.
+            if (format == extensibleFormat && chunkSize >= 40)
+                format = juce::ByteOrder::littleEndianShort(body + 24);
+        }
+        else if (hasId(chunk, "data"))
+        {
+            // A truncated file plays what it has.
+            dataChunk = body;
+            dataSize = juce::jmin(chunkSize, size - (pos + 8));
+            break;
+        }
+
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    if (dataChunk == nullptr || format != pcmFormat || channels < 1 || rate <= 0.0
+        || (bits != 16 && bits != 24 && bits != 32) || blockAlign != channels * bits / 8)
+        return nullptr;
+
+    Ptr sample = new MappedSample(file, std::move(map));
+    sample->frames = dataChunk;
+    sample->numFrames = dataSize / blockAlign;
+    sample->numChannels = channels;
+    sample->frameSize = blockAlign;
+    sample->sampleRate = rate;
+    sample->encoding = bits == 16 ? Encodings::int16 : (bits == 24 ? Encodings::int24 : Encodings::int32);
+    sample->frameScale = (float) (1.0 / (std::ldexp(1.0, bits - 1) * channels));
+
+    if (sample->numFrames == 0)
+        return nullptr;
+
+    return sample;
+}
+
+//==============================================================================
+MappedSample::Ptr MappedSample::Cache::get(const juce::File& file)
+{
+    const juce::ScopedLock sl(lock);
+
+    removeUnused();
+
+    for (auto* sample : samples)
+        if (sample->getFile() == file)
+            return sample;
+
+    auto sample = MappedSample::open(file);
+
+    if (sample != nullptr)
+        samples.add(sample.get());
+
+    return sample;
+}
+
+void MappedSample::Cache::removeUnused()
+{
+    // Only the cache can hand out new references, and only under the lock,
+    // so a sample it holds the last reference to can't be picked up again.
+    for (int i = samples.size(); --i >= 0;)
+        if (samples.getUnchecked(i)->getReferenceCount() == 1)
+            samples.remove(i);
+}
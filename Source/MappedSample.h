@@ -0,0 +1,119 @@
+/*
+  ==============================================================================
+
+    MappedSample.h
+
+    A PCM WAV file played straight out of a read-only memory mapping.
+    Opening one parses the RIFF header and maps the file; nothing is decoded
+    or copied. SampleOscillator converts the 16, 24 or 32-bit integer frames
+    to floating point inside its interpolation loop, as it reads them, so a
+    sample costs address space rather than memory, and the OS pages it in
+    from its file cache only where playback goes.
+
+    Samples are shared through MappedSample::Cache, one per process: every
+    voice of every plugin instance playing the same file reads the same
+    mapping.
+
+    The cache keeps a reference to each sample it hands out and only drops
+    it, on the message thread, once it holds the last one. So a reference
+    released on the audio thread is never the last, and unmapping never
+    happens there.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <memory>
+
+class MappedSample : public juce::ReferenceCountedObject
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<MappedSample>;
+
+    // How each channel of a frame is stored, little-endian.
+    enum class Encodings
+    {
+        int16 = 0,
+        int24,
+        int32
+    };
+
+    // nullptr unless the file is an uncompressed WAV of 16, 24 or 32-bit
+    // integer samples. Use the Cache rather than calling this directly.
+    static Ptr open(const juce::File& file);
+
+    const juce::File& getFile() const noexcept { return file; }
+    juce::int64 getNumFrames() const noexcept { return numFrames; }
+    int getNumChannels() const noexcept { return numChannels; }
+    double getSampleRate() const noexcept { return sampleRate; }
+    Encodings getEncoding() const noexcept { return encoding; }
+
+    // Frame index with its channels averaged, -1 to 1. index must be below
+    // getNumFrames(); encoding must be getEncoding().
+    template <Encodings encoding>
+    float getFrame(juce::int64 index) const noexcept
+    {
+        const char* p = frames + index * frameSize;
+        float sum = 0.0f;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            sum += (float) decode<encoding>(p + ch * bytesPerSample<encoding>());
+
+        return sum * frameScale;
+    }
+
+    //==============================================================================
+    class Cache
+    {
+    public:
+        Cache() = default;
+
+        // The shared sample for this file, mapping it if nobody has it yet;
+        // nullptr if it can't be played. Message thread or other non-realtime
+        // code, as mapping a file is a system call.
+        Ptr get(const juce::File& file);
+
+    private:
+        juce::CriticalSection lock;
+        juce::ReferenceCountedArray<MappedSample> samples;
+
+        // Unmaps every sample only the cache still refers to.
+        void removeUnused();
+
+        JUCE_DECLARE_NON_COPYABLE(Cache)
+    };
+
+private:
+    MappedSample(const juce::File& source, std::unique_ptr<juce::MemoryMappedFile> map);
+
+    template <Encodings encoding>
+    static constexpr int bytesPerSample() noexcept
+    {
+        return encoding == Encodings::int16 ? 2 : (encoding == Encodings::int24 ? 3 : 4);
+    }
+
+    template <Encodings encoding>
+    static int decode(const char* p) noexcept
+    {
+        if constexpr (encoding == Encodings::int16)
+            return (juce::int16) juce::ByteOrder::littleEndianShort(p);
+        else if constexpr (encoding == Encodings::int24)
+            return juce::ByteOrder::littleEndian24Bit(p);
+        else
+            return (int) juce::ByteOrder::littleEndianInt(p);
+    }
+
+    const juce::File file;
+    const std::unique_ptr<juce::MemoryMappedFile> mapping;
+
+    const char* frames = nullptr;  // the "data" chunk, inside the mapping
+    juce::int64 numFrames = 0;
+    int numChannels = 1;
+    int frameSize = 2;             // bytes per frame, all channels
+    double sampleRate = 44100.0;
+    Encodings encoding = Encodings::int16;
+    float frameScale = 1.0f;       // full scale to 1, divided by the channel count
+
+    JUCE_DECLARE_NON_COPYABLE(MappedSample)
+};
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    ModMatrix.cpp
+
+  ==============================================================================
+*/
+
+#include "ModMatrix.h"
+
+void ModMatrix::prepare(const DspContext& context)
+{
+    const int numLfos = WaveFormSettings::numModLfos;
+    const int maximumBlockSize = context.maximumBlockSize;
+    const bool doublePrecision = context.doublePrecision;
+
+    doubleBuffers.lfos.setSize(numLfos, doublePrecision ? maximumBlockSize : 0);
+    doubleBuffers.destinations.setSize(numDestinations, doublePrecision ? maximumBlockSize : 0);
+    floatBuffers.lfos.setSize(numLfos, doublePrecision ? 0 : maximumBlockSize);
+    floatBuffers.destinations.setSize(numDestinations, doublePrecision ? 0 : maximumBlockSize);
+
+    for (auto& lfo : lfos)
+        lfo.prepare(context);
+
+    activeDestinations = lfoDestinations = 0;
+    envelopeAmounts.fill(0.0f);
+    envelopeUsed = false;
+}
+
+template <typename SampleType>
+void ModMatrix::process(const ParameterSnapshot& parameters, int numSamples) noexcept
+{
+    activeDestinations = lfoDestinations = 0;
+    envelopeAmounts.fill(0.0f);
+    envelopeUsed = false;
+
+    auto& buffers = getBuffers<SampleType>();
+
+    // Like the tremolo, the routes sit out a block larger than prepareToPlay promised.
+    jassert(numSamples <= buffers.destinations.getNumSamples());
+
+    if (numSamples > buffers.destinations.getNumSamples())
+        return;
+
+    std::array<bool, WaveFormSettings::numModLfos> lfoRendered{};
+
+    for (const auto& route : parameters.modRoutes)
+    {
+        if (route.source == Sources::none || route.amount == 0.0f)
+            continue;
+
+        const auto d = route.destination;
+        const float amount = route.amount * rangeFor(d);
+        activeDestinations |= bit(d);
+
+        if (route.source == Sources::modEnvelope)
+        {
+            envelopeAmounts[(size_t) d] += amount;
+            envelopeUsed = true;
+            continue;
+        }
+
+        // Each LFO is rendered once per block, however many routes read it.
+        const int l = (route.source == Sources::lfo1) ? 0 : 1;
+        SampleType* lfoData = buffers.lfos.getWritePointer(l);
+
+        if (!lfoRendered[(size_t) l])
+        {
+            const auto& settings = parameters.modLfos[(size_t) l];
+
+            lfos[(size_t) l].render(lfoData, numSamples, settings.wave, ParameterSnapshot::Ramp{ settings.rate, 0.0f },
+                                    [](int, double wave) { return wave; });
+            lfoRendered[(size_t) l] = true;
+        }
+
+        SampleType* dest = buffers.destinations.getWritePointer((int) d);
+
+        if ((lfoDestinations & bit(d)) != 0)
+            juce::FloatVectorOperations::addWithMultiply(dest, lfoData, (SampleType) amount, numSamples);
+        else
+            juce::FloatVectorOperations::copyWithMultiply(dest, lfoData, (SampleType) amount, numSamples);
+
+        lfoDestinations |= bit(d);
+    }
+}
+
+float ModMatrix::rangeFor(Destinations d) noexcept
+{
+    switch (d)
+    {
+        case Destinations::pitch:     return pitchRangeOctaves;
+        case Destinations::cutoff:    return cutoffRangeOctaves;
+        case Destinations::amplitude: return 1.0f;
+        case Destinations::pan:       return 1.0f;
+    }
+
+    return 1.0f;
+}
+
+template void ModMatrix::process<float>(const ParameterSnapshot&, int) noexcept;
+template void ModMatrix::process<double>(const ParameterSnapshot&, int) noexcept;
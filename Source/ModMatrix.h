@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+    ModMatrix.h
+
+    Routes the two global LFOs and the per-voice modulation envelope to
+    pitch, cutoff, amplitude and pan. Once per block process() works out
+    which routes are live and sums every LFO route into one dense buffer per
+    destination; the voices add their own envelope routes on top.
+
+    Only destinations that something is routed to cost anything. The voice
+    kernels are specialised on the set of per-sample destinations (pitch and
+    amplitude), so an unrouted destination has no code in the inner loop at
+    all. Cutoff is applied once per sub-block and pan when the voice is mixed.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "ParameterSnapshot.h"
+#include "ControlRateLfo.h"
+#include "DspContext.h"
+#include "WaveFormSettings.h"
+#include <array>
+#include <type_traits>
+
+class ModMatrix
+{
+public:
+    using Sources = WaveFormSettings::ModSources;
+    using Destinations = WaveFormSettings::ModDestinations;
+
+    static constexpr int numDestinations = 4;
+
+    // What a route amount of 1 does: pitch and cutoff move in octaves, the
+    // amplitude gain is 1 + value and pan runs from -1 (left) to +1 (right).
+    static constexpr float pitchRangeOctaves = 1.0f;
+    static constexpr float cutoffRangeOctaves = 4.0f;
+    static constexpr float maxPitchOctaves = 4.0f;
+
+    // The destinations the voice kernels are specialised on, as a bit set.
+    enum KernelRoutes : unsigned
+    {
+        pitchRoute     = 1 << 0,
+        amplitudeRoute = 1 << 1
+    };
+
+    static constexpr unsigned numKernelRouteSets = 4;
+
+    ModMatrix() = default;
+
+    // Allocates the buffers in the precision the host will render in. Not realtime safe.
+    void prepare(const DspContext& context);
+
+    // Audio thread, once per block, after the snapshot has been captured.
+    template <typename SampleType>
+    void process(const ParameterSnapshot& parameters, int numSamples) noexcept;
+
+    bool isActive(Destinations d) const noexcept { return (activeDestinations & bit(d)) != 0; }
+    bool usesModEnvelope() const noexcept { return envelopeUsed; }
+
+    unsigned getKernelRoutes() const noexcept
+    {
+        return (isActive(Destinations::pitch) ? pitchRoute : 0u)
+             | (isActive(Destinations::amplitude) ? amplitudeRoute : 0u);
+    }
+
+    // Sum of the LFO routes to d for every sample of the block, or nullptr
+    // when no LFO is routed there.
+    template <typename SampleType>
+    const SampleType* getLfoModulation(Destinations d) const noexcept
+    {
+        if ((lfoDestinations & bit(d)) == 0)
+            return nullptr;
+
+        return getBuffers<SampleType>().destinations.getReadPointer((int) d);
+    }
+
+    // Sum of the envelope route amounts to d, in the destination's units.
+    float getEnvelopeAmount(Destinations d) const noexcept { return envelopeAmounts[(size_t) d]; }
+
+    // 2^octaves for |octaves| <= maxPitchOctaves, with only multiplies and
+    // adds so loops over it vectorise: (2^(x/8))^8 with a Taylor series for
+    // the inner power. The relative error is below 2e-6 (0.003 cents).
+    template <typename SampleType>
+    static SampleType octavesToRatio(SampleType octaves) noexcept
+    {
+        const SampleType limited = juce::jlimit((SampleType) -maxPitchOctaves, (SampleType) maxPitchOctaves, octaves);
+        const SampleType y = limited * (SampleType) (0.6931471805599453 / 8.0);
+
+        SampleType r = (SampleType) 1 + y * ((SampleType) 1 + y * ((SampleType) (1.0 / 2.0)
+                     + y * ((SampleType) (1.0 / 6.0) + y * ((SampleType) (1.0 / 24.0)
+                     + y * ((SampleType) (1.0 / 120.0) + y * (SampleType) (1.0 / 720.0))))));
+
+        r *= r;
+        r *= r;
+        r *= r;
+        return r;
+    }
+
+private:
+    template <typename SampleType>
+    struct Buffers
+    {
+        juce::AudioBuffer<SampleType> lfos;         // one channel per LFO, bipolar
+        juce::AudioBuffer<SampleType> destinations; // one channel per destination
+    };
+
+    Buffers<float> floatBuffers;
+    Buffers<double> doubleBuffers;
+
+    std::array<ControlRateLfo, WaveFormSettings::numModLfos> lfos;
+
+    unsigned activeDestinations = 0;
+    unsigned lfoDestinations = 0;
+    std::array<float, numDestinations> envelopeAmounts{};
+    bool envelopeUsed = false;
+
+    static unsigned bit(Destinations d) noexcept { return 1u << (unsigned) d; }
+    static float rangeFor(Destinations d) noexcept;
+
+    template <typename SampleType>
+    const Buffers<SampleType>& getBuffers() const noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleBuffers;
+        else
+            return floatBuffers;
+    }
+
+    template <typename SampleType>
+    Buffers<SampleType>& getBuffers() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleBuffers;
+        else
+            return floatBuffers;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(ModMatrix)
+};
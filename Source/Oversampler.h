@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+    Oversampler.h
+
+    Decimation back to the host rate for the oversampled oscillator. The
+    oscillator renders at 2x, 4x or 8x, and a cascade of polyphase half-band
+    FIR decimators brings the result down one octave per stage. Nothing needs upsampling: the oscillator
+    generates at the high rate directly, so only the decimators cost extra.
+
+    Half-band filters have every other tap zero apart from the centre one,
+    so each stage splits its input into even and odd phases: the even phase
+    goes through the non-zero taps, the odd phase is just delayed and scaled
+    by the centre tap. The taps are applied across the whole block at once,
+    one vectorised multiply-add per tap.
+
+    The filters are linear phase, so the latency is fixed and is reported
+    to the host along with the FIR filter's.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+#include <vector>
+
+template <typename SampleType>
+class HalfbandDecimator
+{
+public:
+    HalfbandDecimator() = default;
+
+    // 4 * halfLength - 1 taps, 2 * halfLength of them non-zero besides the centre.
+    HalfbandDecimator(int halfLength, int maximumOutputBlock)
+        : m(halfLength),
+          taps((size_t) (2 * halfLength)),
+          evens((size_t) (2 * halfLength - 1 + maximumOutputBlock), SampleType(0)),
+          odds((size_t) (halfLength + maximumOutputBlock), SampleType(0)),
+          maxOutput(maximumOutputBlock)
+    {
+        design();
+    }
+
+    // Group delay in samples at this stage's input rate.
+    int getLatencySamples() const noexcept { return 2 * m - 1; }
+
+    void reset() noexcept
+    {
+        std::fill(evens.begin(), evens.end(), SampleType(0));
+        std::fill(odds.begin(), odds.end(), SampleType(0));
+    }
+
+    // Decimates in[0 .. 2 * numOutput) into out[0 .. numOutput). The input
+    // is copied before anything is written, so out may alias in.
+    void process(const SampleType* in, SampleType* out, int numOutput) noexcept
+    {
+        jassert(numOutput <= maxOutput);
+
+        const int history = 2 * m - 1;
+        SampleType* e = evens.data() + history;
+        SampleType* o = odds.data() + m;
+
+        for (int j = 0; j < numOutput; ++j)
+        {
+            e[j] = in[2 * j];
+            o[j] = in[2 * j + 1];
+        }
+
+        // y[j] = 0.5 * odd[j - m] + sum of taps[i] * even[j - (2m - 1) + i]
+        juce::FloatVectorOperations::copyWithMultiply(out, odds.data(), (SampleType) 0.5, numOutput);
+
+        for (int i = 0; i < 2 * m; ++i)
+            juce::FloatVectorOperations::addWithMultiply(out, evens.data() + i, taps[(size_t) i], numOutput);
+
+        std::copy(evens.begin() + numOutput, evens.begin() + numOutput + history, evens.begin());
+        std::copy(odds.begin() + numOutput, odds.begin() + numOutput + m, odds.begin());
+    }
+
+private:
+    int m = 0;
+    std::vector<SampleType> taps;  // the non-zero even-index taps; symmetric, so also oldest-first
+    std::vector<SampleType> evens; // 2m - 1 samples of history, then the block
+    std::vector<SampleType> odds;  // m samples of history, then the block
+    int maxOutput = 0;
+
+    // Kaiser-windowed sinc at a quarter of the input rate. The window keeps
+    // the half-band zeros; the taps are scaled so the gain at DC is exactly 1.
+    void design()
+    {
+        const int centre = 2 * m - 1;
+        const double beta = 8.0;
+        double sum = 0.0;
+        std::vector<double> h(taps.size());
+
+        for (size_t i = 0; i < taps.size(); ++i)
+        {
+            const int k = 2 * (int) i - centre; // odd
+            const double x = (double) k / (double) (centre + 1);
+            const double window = besselI0(beta * std::sqrt(1.0 - x * x)) / besselI0(beta);
+
+            h[i] = std::sin(juce::MathConstants<double>::halfPi * k) / (juce::MathConstants<double>::pi * k) * window;
+            sum += h[i];
+        }
+
+        for (size_t i = 0; i < taps.size(); ++i)
+            taps[i] = (SampleType) (h[i] * 0.5 / sum);
+    }
+
+    static double besselI0(double x) noexcept
+    {
+        double term = 1.0, sum = 1.0;
+
+        for (int k = 1; k < 50 && term > 1e-12 * sum; ++k)
+        {
+            const double f = x / (2.0 * k);
+            term *= f * f;
+            sum += term;
+        }
+
+        return sum;
+    }
+};
+
+template <typename SampleType>
+class Oversampler
+{
+public:
+    static constexpr int maxFactor = 8;
+
+    Oversampler() = default;
+
+    // factor is 1, 2, 4 or 8. Allocates; not realtime safe.
+    Oversampler(int oversamplingFactor, int maximumOutputBlock)
+        : factor(oversamplingFactor)
+    {
+        jassert(factor == 1 || factor == 2 || factor == 4 || factor == 8);
+
+        // The last stage has to be sharp, since it guards the host's whole
+        // band. Earlier ones only have to keep their images out of it, which
+        // leaves them a wide transition band and few taps.
+        static constexpr int lastToFirstHalfLengths[] = { 12, 6, 4 };
+        const int numStages = factor >= 8 ? 3 : factor >= 4 ? 2 : factor >= 2 ? 1 : 0;
+
+        for (int s = 0; s < numStages; ++s)
+        {
+            const int outputFactor = factor >> (s + 1);
+            stages.emplace_back(lastToFirstHalfLengths[numStages - 1 - s], maximumOutputBlock * outputFactor);
+        }
+
+        if (numStages > 1)
+            scratch.resize((size_t) (maximumOutputBlock * factor / 2));
+    }
+
+    int getFactor() const noexcept { return factor; }
+
+    // Latency at the output rate; a linear-phase cascade isn't a whole number of samples.
+    double getLatencySamples() const noexcept
+    {
+        double latency = 0.0;
+        int inputFactor = factor;
+
+        for (const auto& stage : stages)
+        {
+            latency += (double) stage.getLatencySamples() / inputFactor;
+            inputFactor /= 2;
+        }
+
+        return latency;
+    }
+
+    void reset() noexcept
+    {
+        for (auto& stage : stages)
+            stage.reset();
+    }
+
+    // Decimates in[0 .. numOutput * factor) into out[0 .. numOutput).
+    void process(const SampleType* in, SampleType* out, int numOutput) noexcept
+    {
+        const size_t numStages = stages.size();
+
+        if (numStages == 0)
+        {
+            juce::FloatVectorOperations::copy(out, in, numOutput);
+            return;
+        }
+
+        const SampleType* source = in;
+        int length = numOutput * factor;
+
+        for (size_t s = 0; s < numStages; ++s)
+        {
+            length /= 2;
+            SampleType* dest = (s + 1 == numStages) ? out : scratch.data();
+            stages[s].process(source, dest, length);
+            source = dest;
+        }
+    }
+
+private:
+    int factor = 1;
+    std::vector<HalfbandDecimator<SampleType>> stages; // highest rate first
+    std::vector<SampleType> scratch;
+};
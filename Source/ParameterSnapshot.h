@@ -0,0 +1,144 @@
+/*
+  ==============================================================================
+
+    ParameterSnapshot.h
+
+    Every parameter the audio code needs, read from the APVTS once at the
+    start of a block by WaveFormSettings::capture. Voices and the processor
+    read plain fields from it instead of loading atomics per sample.
+
+    Continuous parameters that would zipper when automated are smoothed and
+    carried as a linear Ramp across the block. The change flags say which
+    groups differ from the previous block's snapshot.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "WaveFormSettings.h"
+#include "SampleStreamer.h"
+#include "UserWavetables.h"
+#include <array>
+
+struct ParameterSnapshot
+{
+    // Value at block sample i is start + step * i.
+    struct Ramp
+    {
+        float start = 0.0f;
+        float step = 0.0f;
+
+        float at(int sample) const noexcept { return start + step * (float) sample; }
+        bool isSmoothing() const noexcept { return step != 0.0f; }
+    };
+
+    enum ChangeFlags : juce::uint32
+    {
+        waveChanged         = 1 << 0,
+        cutoffChanged       = 1 << 1,
+        filterLengthChanged = 1 << 2,
+        envelopeChanged     = 1 << 3,
+        tremoloChanged      = 1 << 4,
+        voicesChanged       = 1 << 5,
+        modulationChanged   = 1 << 6,
+        unisonChanged       = 1 << 7,
+        allChanged          = 0xffffffff
+    };
+
+    int numSamples = 0;
+    juce::uint32 changed = allChanged;
+
+    bool hasChanged(ChangeFlags flags) const noexcept { return (changed & flags) != 0; }
+
+    WaveFormSettings::WaveForms wave = WaveFormSettings::WaveForms::sine;
+    int userWavetable = -1;           // UserWavetables slot playing instead of wave, or -1
+    Ramp wavetablePosition{ 0.0f, 0.0f }; // 0 - 1 through a user table's frames
+    Ramp gain{ 1.0f, 0.0f };          // linear, already converted from dB
+
+    int unisonVoices = 1;             // oscillators stacked per note
+    float unisonDetune = 15.0f;       // cents, outermost lane either side
+    float unisonSpread = 0.5f;        // 0 - 1
+
+    float cutoffLow = 20.0f;          // Hz
+    float cutoffHigh = 20000.0f;      // Hz
+    int filterTaps = 101;
+
+    float attack = 100.0f;            // ms
+    float decay = 500.0f;             // ms
+    float sustain = 0.8f;             // 0 - 1
+    float release = 100.0f;           // ms
+
+    bool tremoloOn = false;
+    WaveFormSettings::WaveForms tremoloWave = WaveFormSettings::WaveForms::sine;
+    Ramp tremoloFreq{ 1.0f, 0.0f };   // Hz
+    Ramp tremoloDepth{ 0.0f, 0.0f };  // 0 - 1
+
+    int polyphony = 10;
+    int voiceStealing = 0;
+
+    struct ModRoute
+    {
+        WaveFormSettings::ModSources source = WaveFormSettings::ModSources::none;
+        WaveFormSettings::ModDestinations destination = WaveFormSettings::ModDestinations::pitch;
+        float amount = 0.0f;          // -1 - 1
+
+        bool operator== (const ModRoute& other) const noexcept
+        {
+            return source == other.source && destination == other.destination && amount == other.amount;
+        }
+
+        bool operator!= (const ModRoute& other) const noexcept { return ! operator== (other); }
+    };
+
+    struct ModLfo
+    {
+        WaveFormSettings::WaveForms wave = WaveFormSettings::WaveForms::sine;
+        float rate = 1.0f;            // Hz
+
+        bool operator== (const ModLfo& other) const noexcept { return wave == other.wave && rate == other.rate; }
+        bool operator!= (const ModLfo& other) const noexcept { return ! operator== (other); }
+    };
+
+    std::array<ModRoute, WaveFormSettings::numModRoutes> modRoutes;
+    std::array<ModLfo, WaveFormSettings::numModLfos> modLfos;
+
+    float modAttack = 10.0f;          // ms
+    float modDecay = 300.0f;          // ms
+    float modSustain = 0.5f;          // 0 - 1
+    float modRelease = 300.0f;        // ms
+
+    // Settings of every effect, whether or not it is in the FxChain.
+    struct FxSettings
+    {
+        float chorusRate = 0.8f;          // Hz
+        float chorusDepth = 0.5f;         // 0 - 1
+        float chorusMix = 0.5f;           // 0 - 1
+
+        float flangerRate = 0.25f;        // Hz
+        float flangerDepth = 0.7f;        // 0 - 1
+        float flangerFeedback = 0.5f;     // -0.95 - 0.95
+        float flangerMix = 0.5f;          // 0 - 1
+
+        Ramp delayTime{ 375.0f, 0.0f };   // ms
+        float delayFeedback = 0.35f;      // 0 - 0.95
+        float delayMix = 0.3f;            // 0 - 1
+    };
+
+    FxSettings fx;
+
+    WaveFormSettings::OscillatorModes oscillatorMode = WaveFormSettings::OscillatorModes::wavetable;
+    int sampleRootNote = 60;          // the note the sample plays at its recorded pitch
+    bool sampleLoop = false;
+    bool sampleStreaming = false;     // notes play from SampleStreamer rings, not the mapping
+
+    // Filled in by the processor rather than capture: the sample loaded for
+    // the "Sample" mode and its streaming zone, or nullptr. Valid for the
+    // block; a voice that keeps them takes a reference.
+    MappedSample* sample = nullptr;
+    SampleStreamer::Zone* zone = nullptr;
+
+    // Also the processor's: userWavetable's table, or nullptr if the slot
+    // is empty, when wave plays instead. Valid for the block.
+    const UserWavetables::Table* userTable = nullptr;
+};
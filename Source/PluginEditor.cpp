@@ -20,6 +20,19 @@ static void setUnitFormatting(juce::Slider& s,
         };
 }
 
+static juce::String getEffectLabel(FxChain::Effects effect)
+{
+    switch (effect)
+    {
+        case FxChain::Effects::chorus:    return "Chorus";
+        case FxChain::Effects::flanger:   return "Flanger";
+        case FxChain::Effects::delay:     return "Delay";
+        case FxChain::Effects::dcBlocker: return "DC blocker";
+    }
+
+    return {};
+}
+
 PluginEditor::PluginEditor(JuceSynthPluginAudioProcessor& p)
     : AudioProcessorEditor(&p),
     processor(p),
@@ -100,6 +113,39 @@ PluginEditor::PluginEditor(JuceSynthPluginAudioProcessor& p)
     addAndMakeVisible(promptBox);
     addAndMakeVisible(generateButton);
 
+    initTopLabel(wavetableLabel, "Wavetable:");
+    initTopLabel(wavetableFileLabel, {});
+    initTopLabel(wavetablePositionLabel, "Position:");
+    wavetableFileLabel.setJustificationType(juce::Justification::centredLeft);
+
+    loadWavetableButton.onClick = [this]() { chooseWavetableFile(); };
+    addAndMakeVisible(loadWavetableButton);
+    addAndMakeVisible(wavetablePositionSlider);
+
+    initTopLabel(sampleLabel, "Oscillator:");
+    initTopLabel(sampleFileLabel, {});
+    sampleFileLabel.setJustificationType(juce::Justification::centredLeft);
+
+    loadSampleButton.onClick = [this]() { chooseSampleFile(); };
+    addAndMakeVisible(oscillatorMode);
+    addAndMakeVisible(loadSampleButton);
+
+    initTopLabel(effectsLabel, "Effects:");
+
+    for (int i = 0; i < (int) effectSlots.size(); ++i)
+    {
+        auto& slot = effectSlots[(size_t) i];
+        slot.addItem("None", 1);
+
+        for (int e = 0; e < FxChain::numEffects; ++e)
+            slot.addItem(getEffectLabel((FxChain::Effects) e), e + 2);
+
+        slot.onChange = [this, i]() { effectSlotChanged(i); };
+        addAndMakeVisible(slot);
+    }
+
+    showEffectsChain(processor.getEffectsChain());
+
     // Label
 	tremoloLabel.setText("Tremolo: ", juce::dontSendNotification);
 
@@ -119,6 +165,13 @@ PluginEditor::PluginEditor(JuceSynthPluginAudioProcessor& p)
     waveForm.addItem ("Square", 2);
     waveForm.addItem ("Triangle", 3);
     waveForm.addItem ("Sawtooth", 4);
+    waveForm.addItem ("User 1", 5);
+    waveForm.addItem ("User 2", 6);
+    waveForm.addItem ("User 3", 7);
+    waveForm.addItem ("User 4", 8);
+
+    oscillatorMode.addItem("Wavetable", 1);
+    oscillatorMode.addItem("Sample", 2);
 
     tremoloWaveForm.addItem("Sine", 1);
     tremoloWaveForm.addItem("Square", 2);
@@ -126,6 +179,7 @@ PluginEditor::PluginEditor(JuceSynthPluginAudioProcessor& p)
     tremoloWaveForm.addItem("Sawtooth", 4);
 	tremoloFreqSlider.setRange(0.1, 20.0);
 	tremoloDepthSlider.setRange(0.0, 1.0);
+    wavetablePositionSlider.setRange(0.0, 1.0, 0.01);
 
     // Gain: dB
     decibelSlider.setTextValueSuffix(" dB");
@@ -158,6 +212,12 @@ PluginEditor::PluginEditor(JuceSynthPluginAudioProcessor& p)
     waveAttachment = std::make_unique<ComboBoxAttachment> (
         apvts, "wave", waveForm);
 
+    wavetablePositionAttachment = std::make_unique<SliderAttachment>(
+        apvts, "wavetablePosition", wavetablePositionSlider);
+
+    oscillatorModeAttachment = std::make_unique<ComboBoxAttachment>(
+        apvts, "oscillatorMode", oscillatorMode);
+
     attackAttachment = std::make_unique<SliderAttachment>(
         apvts, "attack", attackSlider);
 
@@ -182,7 +242,7 @@ PluginEditor::PluginEditor(JuceSynthPluginAudioProcessor& p)
 	tremoloFreqAttachment = std::make_unique<SliderAttachment>(
 		apvts, "tremoloFreq", tremoloFreqSlider);
 
-    setSize (650, 415);
+    setSize (650, 559);
 
     startTimerHz (30); 
 }
@@ -361,11 +421,172 @@ void PluginEditor::resized()
         vibratoArea.removeFromLeft(10);
         generateButton.setBounds(vibratoArea.removeFromLeft(80));
     }
+
+    auto wavetableArea = juce::Rectangle<int>(
+        tremoloLabel.getX(),
+        promptBox.getBottom() + gap,
+        getWidth(),
+        rowH
+    ).reduced(5, 0);
+
+    {
+        wavetableLabel.setBounds(wavetableArea.removeFromLeft(80));
+        loadWavetableButton.setBounds(
+            wavetableArea.removeFromLeft(70).withSizeKeepingCentre(70, 26));
+        wavetableArea.removeFromLeft(gap);
+        wavetableFileLabel.setBounds(wavetableArea.removeFromLeft(180));
+        wavetablePositionLabel.setBounds(wavetableArea.removeFromLeft(70));
+        wavetablePositionSlider.setBounds(wavetableArea.withTrimmedRight(10));
+    }
+
+    auto sampleArea = juce::Rectangle<int>(
+        tremoloLabel.getX(),
+        wavetableLabel.getBottom() + gap,
+        getWidth(),
+        rowH
+    ).reduced(5, 0);
+
+    {
+        sampleLabel.setBounds(sampleArea.removeFromLeft(80));
+
+        auto modeArea = sampleArea.removeFromLeft(waveForm.getWidth());
+        oscillatorMode.setBounds(modeArea.withSizeKeepingCentre(modeArea.getWidth(), 33));
+        sampleArea.removeFromLeft(gap);
+
+        loadSampleButton.setBounds(
+            sampleArea.removeFromLeft(70).withSizeKeepingCentre(70, 26));
+        sampleArea.removeFromLeft(gap);
+        sampleFileLabel.setBounds(sampleArea.withTrimmedRight(10));
+    }
+
+    auto effectsArea = juce::Rectangle<int>(
+        tremoloLabel.getX(),
+        sampleLabel.getBottom() + gap,
+        getWidth(),
+        rowH
+    ).reduced(5, 0).withTrimmedRight(10);
+
+    {
+        effectsLabel.setBounds(effectsArea.removeFromLeft(80));
+
+        const int slotW = (effectsArea.getWidth() - (int) (effectSlots.size() - 1) * gap)
+                          / (int) effectSlots.size();
+
+        for (auto& slot : effectSlots)
+        {
+            auto slotArea = effectsArea.removeFromLeft(slotW);
+            slot.setBounds(slotArea.withSizeKeepingCentre(slotArea.getWidth(), 33));
+            effectsArea.removeFromLeft(gap);
+        }
+    }
 }
 
 void PluginEditor::timerCallback()
 {
-    
+    // The file, and whether it's still being built, of the "User" slot the
+    // wave combo shows; loading only applies to those slots.
+    const int slot = waveForm.getSelectedId() - firstUserWaveId;
+    const bool isUserSlot = juce::isPositiveAndBelow(slot, UserWavetables::numSlots);
+
+    juce::String text;
+
+    if (isUserSlot)
+    {
+        const auto file = processor.getWavetableFile(slot);
+
+        if (file == juce::File())
+            text = "No table loaded";
+        else
+            text = file.getFileName() + (processor.isWavetableBuilding() ? " (building)" : "");
+    }
+
+    loadWavetableButton.setEnabled(isUserSlot);
+    wavetablePositionSlider.setEnabled(isUserSlot);
+    wavetableFileLabel.setText(text, juce::dontSendNotification);
+
+    const auto sampleFile = processor.getSampleFile();
+    sampleFileLabel.setText(sampleFile == juce::File() ? juce::String("No sample loaded")
+                                                       : sampleFile.getFileName(),
+                            juce::dontSendNotification);
+
+    // The chain can also change with the plugin state.
+    const auto effects = processor.getEffectsChain();
+
+    if (effects != shownEffects)
+        showEffectsChain(effects);
+}
+
+void PluginEditor::chooseWavetableFile()
+{
+    const int slot = waveForm.getSelectedId() - firstUserWaveId;
+
+    if (!juce::isPositiveAndBelow(slot, UserWavetables::numSlots))
+        return;
+
+    fileChooser = std::make_unique<juce::FileChooser>(
+        "Load a wavetable for User " + juce::String(slot + 1),
+        processor.getWavetableFile(slot),
+        "*.wav");
+
+    fileChooser->launchAsync(
+        juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+        [this, slot](const juce::FileChooser& chooser)
+        {
+            const auto file = chooser.getResult();
+
+            if (file == juce::File() || processor.loadWavetable(slot, file))
+                return;
+
+            juce::AlertWindow::showMessageBoxAsync(
+                juce::MessageBoxIconType::WarningIcon,
+                "Load wavetable",
+                "Couldn't read " + file.getFileName() + " as a 16, 24 or 32-bit PCM WAV.");
+        });
+}
+
+void PluginEditor::effectSlotChanged(int index)
+{
+    auto chain = processor.getEffectsChain();
+    const int id = effectSlots[(size_t) index].getSelectedId();
+
+    // Picking an effect that is already elsewhere in the chain moves it here.
+    chain = chain.withRemoved(index);
+
+    if (id > 1)
+        chain = chain.withInserted(index, (FxChain::Effects) (id - 2));
+
+    processor.setEffectsChain(chain);
+    showEffectsChain(chain);
+}
+
+void PluginEditor::showEffectsChain(const FxChain& chain)
+{
+    for (int i = 0; i < (int) effectSlots.size(); ++i)
+        effectSlots[(size_t) i].setSelectedId(i < chain.size() ? (int) chain[i] + 2 : 1,
+                                              juce::dontSendNotification);
+
+    shownEffects = chain;
+}
+
+void PluginEditor::chooseSampleFile()
+{
+    fileChooser = std::make_unique<juce::FileChooser>(
+        "Load a sample", processor.getSampleFile(), "*.wav");
+
+    fileChooser->launchAsync(
+        juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+        [this](const juce::FileChooser& chooser)
+        {
+            const auto file = chooser.getResult();
+
+            if (file == juce::File() || processor.loadSample(file))
+                return;
+
+            juce::AlertWindow::showMessageBoxAsync(
+                juce::MessageBoxIconType::WarningIcon,
+                "Load sample",
+                "Couldn't play " + file.getFileName() + "; it has to be a 16, 24 or 32-bit PCM WAV.");
+        });
 }
 
 bool PluginEditor::getParamsObject(const juce::var& root, juce::DynamicObject*& outParamsObj)
@@ -29,6 +29,15 @@ private:
     void setParamFromFloat(const juce::String& paramId, float value);
     void setChoiceParamFromComboIndex(const juce::String& paramId, int comboIndex1toN);
 
+    // Asks for a WAV for the "User" slot selected in waveForm.
+    void chooseWavetableFile();
+    void chooseSampleFile();
+
+    // One combo per position in the effects chain; changing one edits the
+    // processor's chain, which is then shown again compacted.
+    void effectSlotChanged(int index);
+    void showEffectsChain(const FxChain& chain);
+
     // Reference to the processor (owned by host)
     JuceSynthPluginAudioProcessor& processor;
 
@@ -53,6 +62,23 @@ private:
 	juce::Slider tremoloFreqSlider;
 	juce::Slider tremoloDepthSlider;
 
+    // "User 1" to "User 4" are combo ids 5 - 8.
+    static constexpr int firstUserWaveId = 5;
+
+    juce::Label wavetableLabel, wavetableFileLabel, wavetablePositionLabel;
+    juce::TextButton loadWavetableButton{ "Load..." };
+    juce::Slider wavetablePositionSlider;
+
+    juce::Label sampleLabel, sampleFileLabel;
+    juce::ComboBox oscillatorMode;
+    juce::TextButton loadSampleButton{ "Load..." };
+
+    juce::Label effectsLabel;
+    std::array<juce::ComboBox, FxChain::numEffects> effectSlots;
+    FxChain shownEffects;
+
+    std::unique_ptr<juce::FileChooser> fileChooser;
+
     juce::TextEditor promptBox;
     juce::TextButton generateButton{ "Generate preset" };
 
@@ -70,6 +96,8 @@ private:
     std::unique_ptr<SliderAttachment> cutoffLowAttachment;
     std::unique_ptr<SliderAttachment> cutoffHighAttachment;
     std::unique_ptr<ComboBoxAttachment> waveAttachment;
+    std::unique_ptr<SliderAttachment> wavetablePositionAttachment;
+    std::unique_ptr<ComboBoxAttachment> oscillatorModeAttachment;
 
     std::unique_ptr<ComboBoxAttachment> tremoloWaveAttachment;
 	std::unique_ptr<ToggleButtonAttachment> tremoloButtonAttachment;
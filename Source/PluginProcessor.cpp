@@ -12,7 +12,7 @@ JuceSynthPluginAudioProcessor::createParameterLayout()
 
     layout.add(std::make_unique<APC>(
         "wave", "Wave",
-        juce::StringArray{ "Sine", "Square", "Triangle", "Sawtooth" }, 0));
+        juce::StringArray{ "Sine", "Square", "Triangle", "Sawtooth", "User 1", "User 2", "User 3", "User 4" }, 0));
 
     layout.add(std::make_unique<APC>(
         "tremoloWave", "TremoloWave",
@@ -28,6 +28,54 @@ JuceSynthPluginAudioProcessor::createParameterLayout()
     layout.add(std::make_unique<APF>(
         "cutoffHigh", "Cutoff High", juce::NormalisableRange<float>(20, 20000, 1), 20000));
 
+    // Longer kernels give steeper slopes; above FIRFilter::fftThresholdTaps they
+    // are convolved with FFTs so the cost per sample stays roughly flat.
+    layout.add(std::make_unique<APC>(
+        "filterLength", "Filter Length",
+        juce::StringArray{ "101 taps", "1023 taps", "4095 taps" }, 0));
+
+    // The IIR engines trade the FIR's linear phase and steep slopes for a
+    // tenth of the cost and no latency; they suit cutoff-modulated patches.
+    // Order matches WaveFormSettings::FilterEngines.
+    layout.add(std::make_unique<APC>(
+        "filterEngine", "Filter Engine",
+        juce::StringArray{ "FIR", "State variable", "Biquad cascade" }, 0));
+
+    // The oscillator runs oversampled and is decimated back to the host rate.
+    // Offline renders can afford a higher factor than live playback.
+    layout.add(std::make_unique<APC>(
+        "oversampling", "Oversampling",
+        juce::StringArray{ "Off", "2x", "4x", "8x" }, 0));
+
+    layout.add(std::make_unique<APC>(
+        "oversamplingOffline", "Oversampling (Offline)",
+        juce::StringArray{ "Off", "2x", "4x", "8x" }, 2));
+
+    // Unison: detuned oscillators stacked inside each voice, mixed before its filter.
+    layout.add(std::make_unique<juce::AudioParameterInt>(
+        "unisonVoices", "Unison Voices", 1, UnisonOscillator::maxLanes, 1));
+
+    layout.add(std::make_unique<APF>(
+        "unisonDetune", "Unison Detune (cents)",
+        juce::NormalisableRange<float>(0.0f, 50.0f, 0.1f), 15.0f));
+
+    layout.add(std::make_unique<APF>(
+        "unisonSpread", "Unison Spread",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.5f));
+
+    // Voices
+    layout.add(std::make_unique<juce::AudioParameterInt>(
+        "polyphony", "Polyphony", 1, SynthEngine::maxVoices, 10));
+
+    // Order matches SynthEngine::StealingPolicy.
+    layout.add(std::make_unique<APC>(
+        "voiceStealing", "Voice Stealing",
+        juce::StringArray{ "Released first", "Oldest", "Quietest" }, 0));
+
+    // Spreads the sounding voices over worker threads; the output is identical.
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        "multiCoreRendering", "Multi-core Rendering", false));
+
     // ADSR
     layout.add(std::make_unique<APF>(
         "attack", "Attack (ms)",
@@ -65,6 +113,131 @@ JuceSynthPluginAudioProcessor::createParameterLayout()
         false
     ));
 
+    // Modulation matrix: two LFOs and a per-voice envelope, each route sending
+    // one of them to pitch (+-1 octave), cutoff (+-4 octaves), amplitude or pan.
+    for (int l = 1; l <= WaveFormSettings::numModLfos; ++l)
+    {
+        const juce::String id = "lfo" + juce::String(l);
+        const juce::String name = "LFO " + juce::String(l);
+
+        layout.add(std::make_unique<APC>(
+            id + "Wave", name + " Wave",
+            juce::StringArray{ "Sine", "Square", "Triangle", "Sawtooth" }, 0));
+
+        layout.add(std::make_unique<APF>(
+            id + "Rate", name + " Rate (Hz)",
+            juce::NormalisableRange<float>(0.01f, 20.0f, 0.01f, 0.5f),
+            1.0f));
+    }
+
+    layout.add(std::make_unique<APF>(
+        "modAttack", "Mod Attack (ms)",
+        juce::NormalisableRange<float>(1.0f, 5000.0f, 1, 0.5f),
+        10.0f));
+
+    layout.add(std::make_unique<APF>(
+        "modDecay", "Mod Decay (ms)",
+        juce::NormalisableRange<float>(1.0f, 5000.0f, 1, 0.5f),
+        300.0f));
+
+    layout.add(std::make_unique<APF>(
+        "modSustain", "Mod Sustain",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f),
+        0.5f));
+
+    layout.add(std::make_unique<APF>(
+        "modRelease", "Mod Release (ms)",
+        juce::NormalisableRange<float>(1.0f, 5000.0f, 1, 0.5f),
+        300.0f));
+
+    // Orders match WaveFormSettings::ModSources and ModDestinations.
+    for (int r = 1; r <= WaveFormSettings::numModRoutes; ++r)
+    {
+        const juce::String id = "mod" + juce::String(r);
+        const juce::String name = "Mod " + juce::String(r);
+
+        layout.add(std::make_unique<APC>(
+            id + "Source", name + " Source",
+            juce::StringArray{ "None", "LFO 1", "LFO 2", "Mod Envelope" }, 0));
+
+        layout.add(std::make_unique<APC>(
+            id + "Destination", name + " Destination",
+            juce::StringArray{ "Pitch", "Cutoff", "Amplitude", "Pan" }, 0));
+
+        layout.add(std::make_unique<APF>(
+            id + "Amount", name + " Amount",
+            juce::NormalisableRange<float>(-1.0f, 1.0f, 0.01f),
+            0.0f));
+    }
+
+    // Effects on the summed output. Which of them run, and in what order, is
+    // the FxChain set with setEffectsChain, not a parameter.
+    layout.add(std::make_unique<APF>(
+        "chorusRate", "Chorus Rate (Hz)",
+        juce::NormalisableRange<float>(0.05f, 5.0f, 0.01f, 0.5f), 0.8f));
+
+    layout.add(std::make_unique<APF>(
+        "chorusDepth", "Chorus Depth",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.5f));
+
+    layout.add(std::make_unique<APF>(
+        "chorusMix", "Chorus Mix",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.5f));
+
+    layout.add(std::make_unique<APF>(
+        "flangerRate", "Flanger Rate (Hz)",
+        juce::NormalisableRange<float>(0.05f, 5.0f, 0.01f, 0.5f), 0.25f));
+
+    layout.add(std::make_unique<APF>(
+        "flangerDepth", "Flanger Depth",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.7f));
+
+    layout.add(std::make_unique<APF>(
+        "flangerFeedback", "Flanger Feedback",
+        juce::NormalisableRange<float>(-FxUnits::maximumFeedback, FxUnits::maximumFeedback, 0.01f), 0.5f));
+
+    layout.add(std::make_unique<APF>(
+        "flangerMix", "Flanger Mix",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.5f));
+
+    layout.add(std::make_unique<APF>(
+        "delayTime", "Delay Time (ms)",
+        juce::NormalisableRange<float>((float) FxUnits::FeedbackDelay<float>::minimumDelayMs,
+                                       (float) FxUnits::FeedbackDelay<float>::maximumDelayMs, 1.0f, 0.5f),
+        375.0f));
+
+    layout.add(std::make_unique<APF>(
+        "delayFeedback", "Delay Feedback",
+        juce::NormalisableRange<float>(0.0f, FxUnits::maximumFeedback, 0.01f), 0.35f));
+
+    layout.add(std::make_unique<APF>(
+        "delayMix", "Delay Mix",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.3f));
+
+    // "Sample" plays the file loaded with loadSample instead of the wave
+    // tables. Order matches WaveFormSettings::OscillatorModes.
+    layout.add(std::make_unique<APC>(
+        "oscillatorMode", "Oscillator Mode",
+        juce::StringArray{ "Wavetable", "Sample" }, 0));
+
+    layout.add(std::make_unique<juce::AudioParameterInt>(
+        "sampleRootNote", "Sample Root Note", 0, 127, 60));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        "sampleLoop", "Sample Loop", false));
+
+    // Streaming reads the sample on a background thread instead of touching
+    // the mapping from the audio thread; the preload covers each note's start.
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        "sampleStreaming", "Sample Streaming", false));
+
+    layout.add(std::make_unique<APF>(
+        "samplePreload", "Sample Preload (ms)",
+        juce::NormalisableRange<float>(10.0f, 2000.0f, 1.0f, 0.5f), 250.0f));
+
+    // Where a multi-frame user wavetable plays, from its first frame to its last.
+    layout.add(std::make_unique<APF>(
+        "wavetablePosition", "Wavetable Position", 0.0f, 1.0f, 0.0f));
 
     return layout;
 }
@@ -74,20 +247,54 @@ JuceSynthPluginAudioProcessor::JuceSynthPluginAudioProcessor()
     , apvts(*this, nullptr, "PARAMS", createParameterLayout())
     , waveFormSettings(apvts)
 {
-    for (int i = 0; i < 10; ++i)
-        synth.addVoice(new WavetableVoice(waveFormSettings));
+    // The whole pool is built up front; the polyphony parameter only caps how
+    // many of them sound, and idle voices cost nothing to render.
+    for (int i = 0; i < SynthEngine::maxVoices; ++i)
+    {
+        auto* voice = new WavetableVoice(parameters, modMatrix, dspContext);
+        voice->setSampleStream(&streamer.getStream(i));
+        synth.addVoice(voice);
+    }
 
     synth.addSound(new WavetableSound());
+
+    apvts.addParameterListener("filterLength", this);
+    apvts.addParameterListener("filterEngine", this);
+    apvts.addParameterListener("oversampling", this);
+    apvts.addParameterListener("oversamplingOffline", this);
+    apvts.addParameterListener("sampleStreaming", this);
+    apvts.addParameterListener("samplePreload", this);
+    apvts.addParameterListener("multiCoreRendering", this);
 }
 
-JuceSynthPluginAudioProcessor::~JuceSynthPluginAudioProcessor() = default;
+JuceSynthPluginAudioProcessor::~JuceSynthPluginAudioProcessor()
+{
+    apvts.removeParameterListener("filterLength", this);
+    apvts.removeParameterListener("filterEngine", this);
+    apvts.removeParameterListener("oversampling", this);
+    apvts.removeParameterListener("oversamplingOffline", this);
+    apvts.removeParameterListener("sampleStreaming", this);
+    apvts.removeParameterListener("samplePreload", this);
+    apvts.removeParameterListener("multiCoreRendering", this);
+
+    if (auto* pending = pendingZone.exchange(nullptr))
+        pending->decReferenceCount();
+}
 
 //==============================================================================
 const juce::String JuceSynthPluginAudioProcessor::getName() const { return JucePlugin_Name; }
 bool JuceSynthPluginAudioProcessor::acceptsMidi() const { return true; }
 bool JuceSynthPluginAudioProcessor::producesMidi() const { return false; }
 bool JuceSynthPluginAudioProcessor::isMidiEffect() const { return false; }
-double JuceSynthPluginAudioProcessor::getTailLengthSeconds() const { return 0.0; }
+
+double JuceSynthPluginAudioProcessor::getTailLengthSeconds() const
+{
+    // The release falls to 1% in the set time, so it takes twice that to
+    // reach the envelope's silence level (1e-4); the filter and the effects
+    // ring on after.
+    return 2.0 * waveFormSettings.getReleaseValue() / 1000.0
+         + getTailSamples() * dspContext.inverseSampleRate;
+}
 
 int JuceSynthPluginAudioProcessor::getNumPrograms() { return 1; }
 int JuceSynthPluginAudioProcessor::getCurrentProgram() { return 0; }
@@ -98,83 +305,413 @@ void JuceSynthPluginAudioProcessor::changeProgramName(int, const juce::String&)
 void JuceSynthPluginAudioProcessor::prepareToPlay(double sampleRate, int _samplesPerBlock)
 {
 	samplesPerBlock = _samplesPerBlock;
-    lfoBuffer.setSize(1, samplesPerBlock);
+
+    // The host picks the precision before calling this, and it can't change
+    // without another prepareToPlay.
+    const bool useDouble = isUsingDoublePrecision();
+    doubleBus.lfoBuffer.setSize(1, useDouble ? samplesPerBlock : 0);
+    floatBus.lfoBuffer.setSize(1, useDouble ? 0 : samplesPerBlock);
+
+    // Everything below reads the rate from the context, so it goes first.
+    dspContext.prepare(sampleRate, samplesPerBlock, useDouble);
+    dspContext.setOversamplingFactor(waveFormSettings.getOversamplingFactor(isNonRealtime()));
 
     synth.setCurrentPlaybackSampleRate(sampleRate);
+    waveFormSettings.prepare(sampleRate);
+    tremoloLfo.prepare(dspContext);
+    modMatrix.prepare(dspContext);
+    synth.prepareRendering(samplesPerBlock, useDouble);
+    synth.setMultiCoreRendering(waveFormSettings.getMultiCoreRendering());
+
+    // Users reserve their lines between clear() and allocate(), then fetch
+    // them again; the storage moves on every prepare.
+    delayLines.clear();
+    effects.reserveDelayLines(delayLines, dspContext);
+    delayLines.allocate(samplesPerBlock, useDouble);
+    effects.prepare(delayLines, dspContext);
+
+    streamer.setEnabled(waveFormSettings.getSampleStreaming());
+    prepareFilters();
+}
+
+void JuceSynthPluginAudioProcessor::prepareFilters()
+{
+    const int taps = waveFormSettings.getFilterTaps();
+    const bool useDouble = dspContext.doublePrecision;
+    const double sampleRate = dspContext.sampleRate;
+    filterEngine = waveFormSettings.getFilterEngine();
+
+    const bool useFir = filterEngine == WaveFormSettings::FilterEngines::fir;
+    auto kernels = useFir ? kernelBank->getTable(sampleRate, taps) : nullptr;
+    int latency = 0;
+
+    // Processing is suspended (or hasn't started), so FIRs the voices may
+    // have taken over can go with them, and ones not yet taken are stale.
+    pendingVoiceFirs.store(nullptr);
+    voiceFirs.reset();
+    preparedFilterTaps = taps;
+
+    dspContext.setOversamplingFactor(waveFormSettings.getOversamplingFactor(isNonRealtime()));
+
+    for (size_t ch = 0; ch < floatBus.filters.size(); ++ch)
+    {
+        floatBus.filters[ch] = {};
+        doubleBus.filters[ch] = {};
+
+        if (!useFir)
+        {
+            floatBus.iirFilters[ch] = IIRBandFilter<float>{ sampleRate, filterEngine };
+            doubleBus.iirFilters[ch] = IIRBandFilter<double>{ sampleRate, filterEngine };
+        }
+        else if (useDouble)
+        {
+            doubleBus.filters[ch] = FIRFilter<double>{ taps, sampleRate, kernels };
+        }
+        else
+        {
+            floatBus.filters[ch] = FIRFilter<float>{ taps, sampleRate, kernels };
+        }
+    }
+
+    busCutoffLow = busCutoffHigh = -1.0f; // force setCutoff on the next block
 
-    // Ported from SynthAudioSource::prepareToPlay:
-    maxiSettings::setup(sampleRate, 2, 1024);
+    // 256 voices' FIRs (partitioned state and spectra) are only worth their
+    // memory while the cutoff is modulated and the filter is per voice. When
+    // the routing switches, the audio thread asks buildVoiceFirs for them,
+    // which adds them without re-preparing the voices; ones no longer used
+    // go at the next prepare.
+    const bool perVoiceFir = useFir && voiceFiltersWanted.load();
 
     // If voices/filters need reset, do it here (safe, not realtime).
-    for (int i = 0; i < synth.getNumVoices(); ++i)
-        if (auto* v = dynamic_cast<WavetableVoice*>(synth.getVoice(i)))
-            v->prepare(sampleRate);
+    for (auto* v : synth.getWavetableVoices())
+    {
+        v->setFilterLength(taps);
+        v->setFilterEngine(filterEngine);
+        v->setKernelTable(kernels);
+        v->setPerVoiceFir(perVoiceFir);
+        v->prepare();
+        latency = v->getFilterLatencySamples() + v->getOversamplingLatencySamples();
+    }
+
+    voiceFiltersReady = !useFir || perVoiceFir;
+    setLatencySamples(latency);
+
+    // Every input sample has left the FIR (history plus any partition
+    // buffering) after this many samples of silence. An IIR never quite
+    // lets go, so it gets a fixed allowance instead.
+    filterTailSamples = (useFir ? taps : juce::roundToInt(IIRBandFilter<double>::tailSeconds * sampleRate)) + latency;
+    tailSamplesLeft = getTailSamples();
+}
+
+void JuceSynthPluginAudioProcessor::parameterChanged(const juce::String& parameterID, float)
+{
+    // Resizing the filters or oversamplers allocates, so it can't happen on
+    // the audio thread; nor can the streamer's rings or a zone's preload.
+    if (parameterID == "filterLength" || parameterID == "filterEngine"
+        || parameterID == "oversampling" || parameterID == "oversamplingOffline")
+    {
+        filtersChanged = true;
+        triggerAsyncUpdate();
+    }
+    else if (parameterID == "sampleStreaming" || parameterID == "samplePreload")
+    {
+        streamingChanged = true;
+        triggerAsyncUpdate();
+    }
+    else if (parameterID == "multiCoreRendering")
+    {
+        // Starting or stopping the worker threads isn't realtime safe either.
+        renderWorkersChanged = true;
+        triggerAsyncUpdate();
+    }
+}
+
+void JuceSynthPluginAudioProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+    juce::AudioProcessor::setNonRealtime(isNonRealtime);
+
+    // Switching between live and offline rendering may change the oversampling.
+    if (getSampleRate() > 0.0 && waveFormSettings.getOversamplingFactor(isNonRealtime) != dspContext.oversamplingFactor)
+    {
+        renderModeChanged = true;
+        triggerAsyncUpdate();
+    }
+}
+
+void JuceSynthPluginAudioProcessor::handleAsyncUpdate()
+{
+    if (streamingChanged.exchange(false))
+        updateSampleStreaming();
+
+    if (renderWorkersChanged.exchange(false))
+        updateRenderWorkers();
+
+    // Most hosts call prepareToPlay after switching to offline rendering,
+    // and that has already applied the factor. Re-preparing again would
+    // suspend processing and reset every voice in the middle of the bounce.
+    const bool factorChanged = renderModeChanged.exchange(false)
+        && waveFormSettings.getOversamplingFactor(isNonRealtime()) != dspContext.oversamplingFactor;
+
+    // Before the first prepareToPlay there is nothing to resize; it will
+    // prepare the filters itself.
+    if (getSampleRate() > 0.0 && (filtersChanged.exchange(false) || factorChanged))
+    {
+        suspendProcessing(true);
+        prepareFilters();
+        suspendProcessing(false);
+    }
+
+    // After any re-prepare, so the FIRs match what the voices were prepared for.
+    if (voiceFirsRequested.exchange(false))
+        buildVoiceFirs();
+}
+
+void JuceSynthPluginAudioProcessor::buildVoiceFirs()
+{
+    // Only for voices prepared without them, and once per prepare.
+    if (getSampleRate() <= 0.0 || filterEngine != WaveFormSettings::FilterEngines::fir
+        || voiceFirs != nullptr || voiceFiltersReady.load() || !voiceFiltersWanted.load())
+        return;
+
+    auto firs = std::make_unique<VoiceFirSet>();
+    const auto numFilters = 2 * synth.getWavetableVoices().size();
+    const double sampleRate = dspContext.sampleRate;
+    auto kernels = kernelBank->getTable(sampleRate, preparedFilterTaps);
+
+    // They all start alike, so one is built and the rest are copies; each
+    // voice moves its pair to its own band.
+    if (dspContext.doublePrecision)
+        firs->doubleFilters.assign(numFilters, FIRFilter<double>{ preparedFilterTaps, sampleRate, kernels });
+    else
+        firs->floatFilters.assign(numFilters, FIRFilter<float>{ preparedFilterTaps, sampleRate, kernels });
+
+    pendingVoiceFirs.store(firs.get(), std::memory_order_release);
+    voiceFirs = std::move(firs);
+}
+
+void JuceSynthPluginAudioProcessor::adoptVoiceFirs(VoiceFirSet& firs) noexcept
+{
+    const auto& voices = synth.getWavetableVoices();
+
+    for (size_t i = 0; i < voices.size(); ++i)
+    {
+        if (dspContext.doublePrecision)
+            voices[i]->adoptFirs(firs.doubleFilters[2 * i], firs.doubleFilters[2 * i + 1]);
+        else
+            voices[i]->adoptFirs(firs.floatFilters[2 * i], firs.floatFilters[2 * i + 1]);
+    }
+
+    voiceFiltersReady = true;
+}
+
+void JuceSynthPluginAudioProcessor::updateSampleStreaming()
+{
+    // A different preload needs a new zone; notes on the old one play it out.
+    const double preloadMs = waveFormSettings.getSamplePreloadMs();
+
+    if (loadedZone != nullptr && loadedZone->getPreloadMs() != preloadMs)
+        publishZone(streamer.createZone(loadedZone->getSample(), preloadMs));
+
+    const bool shouldStream = waveFormSettings.getSampleStreaming();
+
+    if (shouldStream == streamer.isEnabled() || getSampleRate() <= 0.0)
+        return;
+
+    suspendProcessing(true);
+    streamer.setEnabled(shouldStream);
+    suspendProcessing(false);
+}
+
+void JuceSynthPluginAudioProcessor::updateRenderWorkers()
+{
+    const bool shouldUseWorkers = waveFormSettings.getMultiCoreRendering();
+
+    // Before the first prepareToPlay there are no slots to size; it will
+    // start the workers itself.
+    if (shouldUseWorkers == synth.isMultiCoreRendering() || getSampleRate() <= 0.0)
+        return;
+
+    suspendProcessing(true);
+    synth.setMultiCoreRendering(shouldUseWorkers);
+    suspendProcessing(false);
 }
 
 void JuceSynthPluginAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer,
     juce::MidiBuffer& midiMessages)
 {
-    juce::ScopedNoDenormals noDenormals;
+    process(buffer, midiMessages);
+}
+
+void JuceSynthPluginAudioProcessor::processBlock(juce::AudioBuffer<double>& buffer,
+    juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages);
+}
 
-    // Clear any extra output channels
-    for (int ch = getTotalNumInputChannels(); ch < getTotalNumOutputChannels(); ++ch)
-        buffer.clear(ch, 0, buffer.getNumSamples());
+template <typename SampleType>
+void JuceSynthPluginAudioProcessor::process(juce::AudioBuffer<SampleType>& buffer,
+    juce::MidiBuffer& midiMessages)
+{
+    juce::ScopedNoDenormals noDenormals;
 
     // Merge on-screen keyboard MIDI into the host MIDI buffer
     keyboardState.processNextMidiBuffer(midiMessages, 0, buffer.getNumSamples(), true);
 
     buffer.clear();
 
-    for (int i = 0; i < samplesPerBlock; ++i) {
-        auto c = waveFormSettings.getLfoWaveValue();
-        auto freq = waveFormSettings.getLfoFreqValue();
-        auto depth = waveFormSettings.getLfoDepthValue();
+    // Nothing sounding, nothing arriving and the filter and effects have
+    // rung out: the output is silence, so skip the LFOs, the voices, the bus
+    // and the effects.
+    if (synth.isSilent() && midiMessages.isEmpty())
+    {
+        if (tailSamplesLeft <= 0)
+            return;
 
-        if (!waveFormSettings.getLfoOnValue()) {
-            lfoBuffer.setSample(0, i, 1.0);
-            continue;
-        }
+        tailSamplesLeft -= buffer.getNumSamples();
+    }
+    else
+    {
+        tailSamplesLeft = getTailSamples();
+    }
 
-        switch (c) {
-            case WaveFormSettings::WaveForms::sine: {
-                lfoBuffer.setSample(0, i, 1 - 0.5 * depth + 0.5 * depth * tremoloOsc.sinewave(freq));
-                break;
-            }
-            case WaveFormSettings::WaveForms::square: {
-                lfoBuffer.setSample(0, i, 1 - 0.5 * depth + 0.5 * depth * tremoloOsc.square(freq));
-                break;
-            }
-            case WaveFormSettings::WaveForms::triangle: {
-                lfoBuffer.setSample(0, i, 1 - 0.5 * depth + 0.5 * depth * tremoloOsc.triangle(freq));
-                break;
-            }
-            case WaveFormSettings::WaveForms::sawtooth: {
-                lfoBuffer.setSample(0, i, 1 - 0.5 * depth + 0.5 * depth * tremoloOsc.saw(freq));
-                break;
-            }
-        }
+    // Every parameter is read once here; voices see the same snapshot.
+    waveFormSettings.capture(parameters, buffer.getNumSamples());
+
+    // The hand-off reference becomes playingZone's. The streamer still holds
+    // the one playingZone had, so dropping it here never frees a preload or
+    // unmaps a file.
+    if (auto* next = pendingZone.exchange(nullptr, std::memory_order_acq_rel))
+    {
+        playingZone = next;
+        next->decReferenceCountWithoutDeleting();
+    }
+
+    parameters.zone = playingZone.get();
+    parameters.sample = playingZone != nullptr ? playingZone->getSample() : nullptr;
+
+    wavetables.update();
+    parameters.userTable = parameters.userWavetable >= 0 ? wavetables.get(parameters.userWavetable) : nullptr;
+
+    // With the tremolo off the voices get no LFO buffer and use kernels without the multiply.
+    const int numSamples = buffer.getNumSamples();
+    auto& lfoBuffer = getBus<SampleType>().lfoBuffer;
+
+    // A host may not send more than prepareToPlay's block size; if one does,
+    // the tremolo sits this block out rather than overrun the buffer.
+    jassert(numSamples <= lfoBuffer.getNumSamples());
+    const bool lfoOn = parameters.tremoloOn && numSamples <= lfoBuffer.getNumSamples();
+
+    if (lfoOn)
+    {
+        const auto depth = parameters.tremoloDepth;
+
+        tremoloLfo.render(lfoBuffer.getWritePointer(0), numSamples, parameters.tremoloWave, parameters.tremoloFreq,
+                          [depth](int offset, double wave)
+                          {
+                              const double d = depth.at(offset);
+                              return 1.0 - 0.5 * d + 0.5 * d * wave;
+                          });
+    }
+
+    modMatrix.process<SampleType>(parameters, numSamples);
+
+    // FIRs the message thread has built for the voices since the last block.
+    if (auto* firs = pendingVoiceFirs.exchange(nullptr, std::memory_order_acquire))
+        adoptVoiceFirs(*firs);
+
+    // A modulated cutoff differs per voice, so the bus can't filter the mix.
+    // Until the voices' FIRs have been built the bus goes on filtering, at
+    // the unmodulated cutoff.
+    const bool wantsPerVoice = modMatrix.isActive(ModMatrix::Destinations::cutoff);
+    voiceFiltersWanted.store(wantsPerVoice);
+
+    if (wantsPerVoice && !voiceFiltersReady && !voiceFirsRequested.exchange(true))
+        triggerAsyncUpdate();
+
+    const auto routing = wantsPerVoice && voiceFiltersReady ? FilterRouting::perVoice
+                                                            : FilterRouting::globalBus;
+
+    // The bus hasn't heard the voices while they filtered themselves; what
+    // it still holds is from before the switch.
+    if (routing == FilterRouting::globalBus && filterRouting == FilterRouting::perVoice)
+    {
+        for (auto& f : getBus<SampleType>().filters)
+            f.reset();
+
+        for (auto& f : getBus<SampleType>().iirFilters)
+            f.reset();
     }
 
-	for (int i = 0; i < synth.getNumVoices(); ++i)
-	{
-		if (auto* voice = dynamic_cast<WavetableVoice*>(synth.getVoice(i)))
-		{
-			voice->setGlobalLfo(lfoBuffer.getReadPointer(0));
-		}
-	}
+    filterRouting = routing;
+
+    const bool filterPerVoice = (filterRouting == FilterRouting::perVoice);
+
+    synth.setVoiceOptions(lfoOn ? lfoBuffer.getReadPointer(0) : nullptr, filterPerVoice);
+
+    if (parameters.hasChanged(ParameterSnapshot::voicesChanged))
+    {
+        synth.setPolyphony(parameters.polyphony);
+        synth.setStealingPolicy((SynthEngine::StealingPolicy) parameters.voiceStealing);
+    }
 
     // Render
     synth.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
 
+    if (!filterPerVoice)
+        applyFilterBus(buffer);
+
+    effects.process(buffer, parameters.fx);
+
     // Apply gain parameter (optional; you can also apply inside voices)
-    const float gainDb = apvts.getRawParameterValue("gain")->load();
-    buffer.applyGain(juce::Decibels::decibelsToGain(gainDb));
+    buffer.applyGainRamp(0, buffer.getNumSamples(), (SampleType) parameters.gain.start,
+                         (SampleType) parameters.gain.at(buffer.getNumSamples()));
+}
+
+template <typename SampleType>
+void JuceSynthPluginAudioProcessor::applyFilterBus(juce::AudioBuffer<SampleType>& buffer)
+{
+    auto& bus = getBus<SampleType>();
+    const bool useFir = filterEngine == WaveFormSettings::FilterEngines::fir;
+
+    const float low = parameters.cutoffLow;
+    const float high = parameters.cutoffHigh;
+
+    if (low != busCutoffLow || high != busCutoffHigh)
+    {
+        busCutoffLow = low;
+        busCutoffHigh = high;
+
+        if (useFir)
+            for (auto& f : bus.filters)
+                f.setCutoff(low, high);
+        else
+            for (auto& f : bus.iirFilters)
+                f.setCutoff(low, high);
+    }
+
+    const int numChannels = juce::jmin(buffer.getNumChannels(), (int) bus.filters.size());
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        SampleType* data = buffer.getWritePointer(ch);
+
+        if (useFir)
+            bus.filters[(size_t) ch].process(data, data, buffer.getNumSamples());
+        else
+            bus.iirFilters[(size_t) ch].process(data, data, buffer.getNumSamples());
+    }
 }
 
 //==============================================================================
 void JuceSynthPluginAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
     auto state = apvts.copyState();
+    state.setProperty("fxChain", effects.getChain().toString(), nullptr);
+    state.setProperty("sampleFile", getSampleFile().getFullPathName(), nullptr);
+
+    for (int slot = 0; slot < UserWavetables::numSlots; ++slot)
+        state.setProperty("wavetable" + juce::String(slot + 1), getWavetableFile(slot).getFullPathName(), nullptr);
+
     std::unique_ptr<juce::XmlElement> xml(state.createXml());
     copyXmlToBinary(*xml, destData);
 }
@@ -183,7 +720,62 @@ void JuceSynthPluginAudioProcessor::setStateInformation(const void* data, int si
 {
     std::unique_ptr<juce::XmlElement> xml(getXmlFromBinary(data, sizeInBytes));
     if (xml && xml->hasTagName(apvts.state.getType()))
+    {
         apvts.replaceState(juce::ValueTree::fromXml(*xml));
+        effects.setChain(FxChain::fromString(apvts.state.getProperty("fxChain").toString()));
+
+        const auto samplePath = apvts.state.getProperty("sampleFile").toString();
+
+        if (samplePath.isNotEmpty())
+            loadSample(juce::File(samplePath));
+
+        for (int slot = 0; slot < UserWavetables::numSlots; ++slot)
+        {
+            const auto path = apvts.state.getProperty("wavetable" + juce::String(slot + 1)).toString();
+
+            if (path.isNotEmpty())
+                loadWavetable(slot, juce::File(path));
+        }
+    }
+}
+
+bool JuceSynthPluginAudioProcessor::loadSample(const juce::File& file)
+{
+    auto sample = sampleCache->get(file);
+
+    if (sample == nullptr)
+        return false;
+
+    publishZone(streamer.createZone(sample, waveFormSettings.getSamplePreloadMs()));
+    return true;
+}
+
+void JuceSynthPluginAudioProcessor::publishZone(SampleStreamer::Zone::Ptr zone)
+{
+    loadedZone = zone;
+
+    // The pointer in pendingZone carries a reference of its own, which the
+    // audio thread takes over; one it never picked up is dropped here.
+    zone->incReferenceCount();
+
+    if (auto* superseded = pendingZone.exchange(zone.get(), std::memory_order_acq_rel))
+        superseded->decReferenceCount();
+}
+
+juce::File JuceSynthPluginAudioProcessor::getSampleFile() const
+{
+    return loadedZone != nullptr ? loadedZone->getSample()->getFile() : juce::File();
+}
+
+bool JuceSynthPluginAudioProcessor::loadWavetable(int slot, const juce::File& file)
+{
+    auto source = sampleCache->get(file);
+
+    if (source == nullptr)
+        return false;
+
+    wavetables.load(slot, std::move(source));
+    return true;
 }
 
 //==============================================================================
@@ -1,12 +1,25 @@
 #pragma once
 #include <JuceHeader.h>
 
+#include "SynthEngine.h"
 #include "WavetableVoice.h"
 #include "WavetableSound.h"
 #include "WaveFormSettings.h"
-#include "maximilian.h"
+#include "ParameterSnapshot.h"
+#include "ControlRateLfo.h"
+#include "ModMatrix.h"
+#include "DspContext.h"
+#include "IIRBandFilter.h"
+#include "DelayLineArena.h"
+#include "FxStage.h"
+#include "MappedSample.h"
+#include "SampleStreamer.h"
+#include "UserWavetables.h"
+#include <atomic>
 
-class JuceSynthPluginAudioProcessor : public juce::AudioProcessor
+class JuceSynthPluginAudioProcessor : public juce::AudioProcessor,
+                                      private juce::AudioProcessorValueTreeState::Listener,
+                                      private juce::AsyncUpdater
 {
 public:
     JuceSynthPluginAudioProcessor();
@@ -16,6 +29,9 @@ public:
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override {}
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+    void setNonRealtime(bool isNonRealtime) noexcept override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -45,15 +61,160 @@ public:
     juce::AudioProcessorValueTreeState apvts;
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 
+    // The effects after the synth, in order. Safe from any thread; a new
+    // chain takes over at the start of the next block, e.g.
+    // setEffectsChain(getEffectsChain().withInserted(0, FxChain::Effects::chorus)).
+    FxChain getEffectsChain() const noexcept { return effects.getChain(); }
+    void setEffectsChain(const FxChain& chain) noexcept { effects.setChain(chain); }
+
+    // Memory-maps a 16, 24 or 32-bit PCM WAV for the "Sample" oscillator
+    // mode; voices play it from their next note. Returns false, keeping the
+    // current sample, if the file can't be played. Message thread.
+    bool loadSample(const juce::File& file);
+    juce::File getSampleFile() const;
+
+    // With "sampleStreaming" on: samples rendered as silence because a voice
+    // outran the disk, and the fewest frames a voice had buffered ahead,
+    // since the last reset. Any thread.
+    juce::int64 getStreamingUnderruns() const noexcept { return streamer.getUnderrunSamples(); }
+    int getLowestStreamingPrefetch() const noexcept { return streamer.getLowestPrefetchFrames(); }
+    void resetStreamingStatistics() noexcept { streamer.resetStatistics(); }
+
+    // Builds a wavetable from a 16, 24 or 32-bit PCM WAV for "User 1" to
+    // "User 4" (slot 0 - 3) of "wave", in the background; the slot keeps
+    // its current table until the new one is ready. Returns false if the
+    // file can't be read. Message thread.
+    bool loadWavetable(int slot, const juce::File& file);
+    juce::File getWavetableFile(int slot) const { return wavetables.getFile(slot); }
+    bool isWavetableBuilding() const noexcept { return wavetables.isBuilding(); }
+
 private:
-    juce::Synthesiser synth;
-	juce::AudioBuffer<double> lfoBuffer;
-	maxiOsc tremoloOsc;
+    // This instance's rate, oversampling and precision; every voice reads it.
+    DspContext dspContext;
+
+    SynthEngine synth;
+
+    // The tremolo gain is evaluated at control rate and interpolated in
+    // between; it changes far too slowly to need more.
+    ControlRateLfo tremoloLfo;
+
+    // Read by every voice; processed at the top of each block.
+    ModMatrix modMatrix;
+
+    // Every delay line this instance runs is cut from here at prepareToPlay.
+    DelayLineArena delayLines;
+
+    // Chorus, flanger, delay and DC blocker on the summed output.
+    FxStage effects;
 
     int samplesPerBlock;
 
+    // Once the engine is silent the filter bus and then the effects still
+    // ring out for up to getTailSamples(); after that a block with no MIDI
+    // is just cleared. Every reset of the countdown uses it.
+    int filterTailSamples = 0;
+    int tailSamplesLeft = 0;
+
+    int getTailSamples() const noexcept { return filterTailSamples + effects.getTailSamples(); }
+
+    // All voices share one cutoff, so by default the summed voices are filtered
+    // once per channel instead of once per voice. Per-voice filters are only
+    // used while a mod matrix route moves the cutoff.
+    enum class FilterRouting { globalBus, perVoice };
+    FilterRouting filterRouting = FilterRouting::globalBus;
+
+    // The audio thread's routing, which decides whether prepareFilters
+    // builds the per-voice FIRs; and whether the voices have them now.
+    std::atomic<bool> voiceFiltersWanted{ false };
+    std::atomic<bool> voiceFiltersReady{ false };
+
+    // Every voice's pair of FIRs (left, right), in the precision in use,
+    // for voices that were prepared without them. Built on the message
+    // thread while the voices play on, and taken over by the audio thread
+    // at the start of a block. The set is the message thread's and only
+    // goes in prepareFilters, so the audio thread never frees one.
+    struct VoiceFirSet
+    {
+        std::vector<FIRFilter<float>> floatFilters;
+        std::vector<FIRFilter<double>> doubleFilters;
+    };
+
+    std::unique_ptr<VoiceFirSet> voiceFirs;
+    std::atomic<VoiceFirSet*> pendingVoiceFirs{ nullptr };
+    int preparedFilterTaps = 0;
+
+    // Which filter the bus and the voices were last prepared with.
+    WaveFormSettings::FilterEngines filterEngine = WaveFormSettings::FilterEngines::fir;
+
+    // The LFO buffer and bus filters in the precision the host renders in.
+    // Only the one matching isUsingDoublePrecision() is allocated, and only
+    // the filters of the selected engine are prepared.
+    template <typename SampleType>
+    struct BusState
+    {
+        juce::AudioBuffer<SampleType> lfoBuffer;
+        std::array<FIRFilter<SampleType>, 2> filters;        // FIR engine
+        std::array<IIRBandFilter<SampleType>, 2> iirFilters; // the other engines
+    };
+
+    BusState<float> floatBus;
+    BusState<double> doubleBus;
+    float busCutoffLow = -1.0f, busCutoffHigh = -1.0f;
+
+    template <typename SampleType>
+    BusState<SampleType>& getBus() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleBus;
+        else
+            return floatBus;
+    }
+
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages);
+
+    template <typename SampleType>
+    void applyFilterBus(juce::AudioBuffer<SampleType>& buffer);
+    void prepareFilters();
+    void buildVoiceFirs();
+    void adoptVoiceFirs(VoiceFirSet& firs) noexcept;
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    void updateSampleStreaming();
+    void updateRenderWorkers();
+    void publishZone(SampleStreamer::Zone::Ptr zone);
+
+    // What the next async update has to redo.
+    std::atomic<bool> filtersChanged{ false };
+    std::atomic<bool> voiceFirsRequested{ false };
+    std::atomic<bool> streamingChanged{ false };
+    std::atomic<bool> renderWorkersChanged{ false };
+    std::atomic<bool> renderModeChanged{ false };  // only if prepareToPlay hasn't caught up
+
     // This must be processor-owned and NOT depend on GUI widgets.
     WaveFormSettings waveFormSettings;
 
+    // Captured from waveFormSettings at the top of every processBlock.
+    ParameterSnapshot parameters;
+
+    // Shared by every instance in the process; keeps the bank's builder alive.
+    juce::SharedResourcePointer<FIRKernelBank> kernelBank;
+
+    // Every instance maps a given file once, through this.
+    juce::SharedResourcePointer<MappedSample::Cache> sampleCache;
+
+    // One stream per voice; the reader thread only runs while streaming is on.
+    SampleStreamer streamer{ SynthEngine::maxVoices };
+
+    // The loaded sample, as a zone of the streamer whether it streams or
+    // not. loadedZone is the message thread's; playingZone the audio
+    // thread's. A new zone passes between them through pendingZone.
+    SampleStreamer::Zone::Ptr loadedZone;
+    std::atomic<SampleStreamer::Zone*> pendingZone{ nullptr };
+    SampleStreamer::Zone::Ptr playingZone;
+
+    // The "User" slots of "wave"; each table is built on the bank's thread.
+    UserWavetables wavetables;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(JuceSynthPluginAudioProcessor)
 };
@@ -0,0 +1,246 @@
+/*
+  ==============================================================================
+
+    SampleOscillator.h
+
+    Plays a MappedSample at the pitch of a note, for the voice's "Sample"
+    oscillator mode. The file's frames are read and converted to floating
+    point inside the interpolation loop, with the loop specialised per
+    encoding, so the stored format is only looked at once per block and
+    nothing is ever decoded ahead of the play head.
+
+    The position is kept in double whatever the render precision, so long
+    samples keep sub-sample accuracy far into the file. A one-shot sample
+    ends after its last frame; a looped one wraps round to its start.
+
+    A note given a SampleStreamer zone doesn't touch the file at all: it
+    plays the zone's preload, then the frames the streamer's reader has put
+    in the voice's ring. There the position counts frames since the note
+    began and isn't wrapped, as the ring doesn't wrap a looped sample
+    either. A zone whose preload is the whole sample needs no ring.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "MappedSample.h"
+#include "SampleStreamer.h"
+#include "DspContext.h"
+#include <cmath>
+#include <limits>
+
+class SampleOscillator
+{
+public:
+    SampleOscillator() = default;
+
+    // The voice's ring, used for notes that stream. Set once.
+    void setStream(SampleStreamer::Stream* voiceStream) noexcept { stream = voiceStream; }
+
+    // Plays sample from its first frame; at rootNote it sounds at its
+    // recorded pitch. A null sample renders silence. With a zone (of the
+    // same sample) the note streams, if the streamer is enabled. Call at
+    // note-on.
+    void start(MappedSample* newSample, SampleStreamer::Zone* zoneToStream, double hz, int rootNote, bool shouldLoop,
+               const DspContext& context) noexcept
+    {
+        sample = newSample;
+        rootHz = juce::MidiMessage::getMidiNoteInHertz(rootNote);
+        looping = shouldLoop;
+        position = 0.0;
+        ended = sample == nullptr;
+        setFrequency(hz, context);
+
+        const bool shouldStream = zoneToStream != nullptr && !ended && stream != nullptr;
+        zone = shouldStream ? zoneToStream : nullptr;
+        resident = shouldStream && zoneToStream->getNumPreloaded() == sample->getNumFrames();
+
+        if (shouldStream && ! resident)
+        {
+            streamEpoch = stream->getEpoch();
+            stream->start(zoneToStream, looping);
+        }
+    }
+
+    // The note is over; the reader can stop filling its ring.
+    void stop() noexcept
+    {
+        if (zone != nullptr && ! resident)
+            stream->stop();
+
+        zone = nullptr;
+        ended = true;
+    }
+
+    // Frames per oscillator sample; also call when the context's rate changes.
+    void setFrequency(double hz, const DspContext& context) noexcept
+    {
+        if (sample != nullptr)
+            increment = hz / rootHz * sample->getSampleRate() * context.inverseOscillatorSampleRate;
+    }
+
+    // Past the end of a one-shot sample, or there was none to play.
+    bool hasEnded() const noexcept { return ended; }
+
+    // With pitchOn, ratio[i] multiplies the playback rate at sample i.
+    template <typename SampleType, bool pitchOn>
+    void render(SampleType* dest, int numSamples, const SampleType* ratio) noexcept
+    {
+        if (ended)
+        {
+            juce::FloatVectorOperations::clear(dest, numSamples);
+            return;
+        }
+
+        if (zone != nullptr)
+        {
+            if (resident || stream->getEpoch() == streamEpoch)
+            {
+                renderStreamed<SampleType, pitchOn>(dest, numSamples, ratio);
+                return;
+            }
+
+            // Streaming was switched off (or on again) under the note: go on
+            // from the same place in the mapped file.
+            zone = nullptr;
+            position = std::fmod(position, (double) sample->getNumFrames());
+        }
+
+        using Encodings = MappedSample::Encodings;
+
+        switch (sample->getEncoding())
+        {
+            case Encodings::int16: renderFrames<Encodings::int16, SampleType, pitchOn>(dest, numSamples, ratio); break;
+            case Encodings::int24: renderFrames<Encodings::int24, SampleType, pitchOn>(dest, numSamples, ratio); break;
+            case Encodings::int32: renderFrames<Encodings::int32, SampleType, pitchOn>(dest, numSamples, ratio); break;
+        }
+    }
+
+private:
+    template <typename SampleType, bool pitchOn>
+    void renderStreamed(SampleType* dest, int numSamples, const SampleType* ratio) noexcept
+    {
+        const float* preload = zone->getPreload();
+        const juce::int64 numPreloaded = zone->getNumPreloaded();
+        const juce::int64 numFrames = sample->getNumFrames();
+        const auto ring = resident ? SampleStreamer::Stream::View() : stream->read();
+        const juce::int64 available = resident ? std::numeric_limits<juce::int64>::max()
+                                               : juce::jmax(numPreloaded, ring.firstFrame + ring.numReady);
+        double p = position;
+
+        // A resident zone loops round its preload instead.
+        const auto frameAt = [&](juce::int64 frame) noexcept
+        {
+            if (frame < numPreloaded)
+                return preload[frame];
+
+            return resident ? preload[frame % numPreloaded] : ring[frame];
+        };
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto index = (juce::int64) p;
+            const bool last = ! looping && index + 1 >= numFrames;
+
+            // Never wait on the reader: whatever hasn't arrived is silence.
+            if ((last ? index : index + 1) >= available)
+            {
+                juce::FloatVectorOperations::clear(dest + i, numSamples - i);
+                stream->reportUnderrun(numSamples - i);
+                break;
+            }
+
+            const auto frac = (SampleType) (p - (double) index);
+            const auto a = (SampleType) frameAt(index);
+            SampleType b = 0;
+
+            if (! last)
+                b = (SampleType) frameAt(index + 1);
+
+            dest[i] = a + frac * (b - a);
+
+            if constexpr (pitchOn)
+                p += increment * (double) ratio[i];
+            else
+                p += increment;
+
+            if (! looping && p >= (double) numFrames)
+            {
+                juce::FloatVectorOperations::clear(dest + i + 1, numSamples - i - 1);
+                ended = true;
+                break;
+            }
+        }
+
+        position = p;
+
+        if (resident)
+            return;
+
+        // The rest of a one-shot sample may all be buffered; that is as
+        // deep as its prefetch can get, not a close call.
+        if (looping || available < numFrames)
+            stream->reportPrefetch(available - (juce::int64) p);
+
+        stream->release((juce::int64) p);
+    }
+
+    template <MappedSample::Encodings encoding, typename SampleType, bool pitchOn>
+    void renderFrames(SampleType* dest, int numSamples, const SampleType* ratio) noexcept
+    {
+        const auto& s = *sample;
+        const juce::int64 numFrames = s.getNumFrames();
+        const auto length = (double) numFrames;
+        double p = position;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto index = (juce::int64) p;
+            const auto frac = (SampleType) (p - (double) index);
+
+            // After the last frame comes the first again, or silence.
+            const SampleType a = (SampleType) s.getFrame<encoding>(index);
+            SampleType b = 0;
+
+            if (index + 1 < numFrames)
+                b = (SampleType) s.getFrame<encoding>(index + 1);
+            else if (looping)
+                b = (SampleType) s.getFrame<encoding>(0);
+
+            dest[i] = a + frac * (b - a);
+
+            if constexpr (pitchOn)
+                p += increment * (double) ratio[i];
+            else
+                p += increment;
+
+            if (p >= length)
+            {
+                if (! looping)
+                {
+                    juce::FloatVectorOperations::clear(dest + i + 1, numSamples - i - 1);
+                    ended = true;
+                    break;
+                }
+
+                p = std::fmod(p, length);
+            }
+        }
+
+        position = p;
+    }
+
+    // The voice holds its own reference, so the sample stays mapped until
+    // the voice's next note even if the processor moves on to another one.
+    MappedSample::Ptr sample;
+    SampleStreamer::Zone::Ptr zone;            // set while the note streams
+    SampleStreamer::Stream* stream = nullptr;
+    juce::uint32 streamEpoch = 0;
+    bool resident = false;                     // the zone holds every frame
+    double rootHz = 261.63;
+    double increment = 0.0;   // frames per oscillator sample
+    double position = 0.0;    // frames from the start
+    bool looping = false;
+    bool ended = true;
+};
@@ -0,0 +1,223 @@
+/*
+  ==============================================================================
+
+    SampleStreamer.cpp
+
+  ==============================================================================
+*/
+
+#include "SampleStreamer.h"
+#include <cmath>
+
+namespace
+{
+    // Frames first .. first + numFrames of the note into dest; past the end
+    // of the file a looped note starts again from its first frame.
+    template <MappedSample::Encodings encoding>
+    void decode(const MappedSample& sample, juce::int64 first, float* dest, int numFrames) noexcept
+    {
+        const juce::int64 length = sample.getNumFrames();
+        juce::int64 frame = first % length;
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            dest[i] = sample.getFrame<encoding>(frame);
+
+            if (++frame == length)
+                frame = 0;
+        }
+    }
+
+    void decode(const MappedSample& sample, juce::int64 first, float* dest, int numFrames) noexcept
+    {
+        using Encodings = MappedSample::Encodings;
+
+        switch (sample.getEncoding())
+        {
+            case Encodings::int16: decode<Encodings::int16>(sample, first, dest, numFrames); break;
+            case Encodings::int24: decode<Encodings::int24>(sample, first, dest, numFrames); break;
+            case Encodings::int32: decode<Encodings::int32>(sample, first, dest, numFrames); break;
+        }
+    }
+}
+
+//==============================================================================
+SampleStreamer::Zone::Zone(MappedSample::Ptr sampleToPlay, double ms)
+    : sample(std::move(sampleToPlay)), preloadMs(ms)
+{
+    const auto wanted = (juce::int64) std::ceil(preloadMs * 0.001 * sample->getSampleRate());
+    preload.resize((size_t) juce::jlimit((juce::int64) 1, sample->getNumFrames(), wanted));
+    decode(*sample, 0, preload.data(), (int) preload.size());
+}
+
+//==============================================================================
+void SampleStreamer::Stream::start(Zone* newZone, bool shouldLoop) noexcept
+{
+    requestedZone.store(newZone);
+    requestedLoop.store(shouldLoop);
+    requested.fetch_add(1);
+
+    firstFrame = newZone != nullptr ? newZone->getNumPreloaded() : 0;
+}
+
+SampleStreamer::Stream::View SampleStreamer::Stream::read() noexcept
+{
+    View view;
+    view.firstFrame = firstFrame;
+
+    // Until the reader has reset the ring for this note, it belongs to the last one.
+    if (ring.empty() || acknowledged.load(std::memory_order_acquire) != requested.load(std::memory_order_relaxed))
+        return view;
+
+    int size1, start2, size2;
+    view.numReady = fifo.getNumReady();
+    fifo.prepareToRead(view.numReady, view.start, size1, start2, size2);
+    view.ring = ring.data();
+    return view;
+}
+
+void SampleStreamer::Stream::release(juce::int64 playHead) noexcept
+{
+    if (ring.empty() || acknowledged.load(std::memory_order_acquire) != requested.load(std::memory_order_relaxed))
+        return;
+
+    const auto done = (int) juce::jlimit((juce::int64) 0, (juce::int64) fifo.getNumReady(), playHead - firstFrame);
+
+    fifo.finishedRead(done);
+    firstFrame += done;
+}
+
+void SampleStreamer::Stream::reportUnderrun(int numSamples) noexcept
+{
+    owner.underrunSamples.fetch_add(numSamples, std::memory_order_relaxed);
+}
+
+void SampleStreamer::Stream::reportPrefetch(juce::int64 framesAhead) noexcept
+{
+    // Voices may render on several threads at once.
+    const int frames = (int) juce::jmin(framesAhead, (juce::int64) std::numeric_limits<int>::max());
+    int lowest = owner.lowestPrefetch.load(std::memory_order_relaxed);
+
+    while (frames < lowest && ! owner.lowestPrefetch.compare_exchange_weak(lowest, frames, std::memory_order_relaxed))
+    {
+    }
+}
+
+void SampleStreamer::Stream::service()
+{
+    // Like a seqlock: the request only counts if no new note replaced it
+    // while its fields were being read.
+    const auto generation = requested.load();
+
+    if (generation != serving)
+    {
+        auto* z = requestedZone.load();
+        const bool l = requestedLoop.load();
+
+        if (requested.load() != generation)
+            return;
+
+        // The voice holds a reference to z, and zones are only deleted under
+        // the lock this runs under, so z is still alive here.
+        zone = z;
+        loop = l;
+        serving = generation;
+        nextFrame = zone != nullptr ? zone->getNumPreloaded() : 0;
+        fifo.reset();
+        acknowledged.store(generation, std::memory_order_release);
+    }
+
+    if (zone == nullptr)
+        return;
+
+    const auto& sample = *zone->getSample();
+    juce::int64 wanted = juce::jmin(fifo.getFreeSpace(), maxFramesPerPass);
+
+    if (! loop)
+        wanted = juce::jmin(wanted, sample.getNumFrames() - nextFrame);
+
+    if (wanted <= 0)
+        return;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite((int) wanted, start1, size1, start2, size2);
+
+    decode(sample, nextFrame, ring.data() + start1, size1);
+    decode(sample, nextFrame + size1, ring.data() + start2, size2);
+
+    fifo.finishedWrite(size1 + size2);
+    nextFrame += size1 + size2;
+}
+
+//==============================================================================
+SampleStreamer::SampleStreamer(int numStreams)
+    : juce::Thread("Sample streamer")
+{
+    for (int i = 0; i < numStreams; ++i)
+        streams.push_back(std::make_unique<Stream>(*this));
+}
+
+SampleStreamer::~SampleStreamer()
+{
+    stopThread(2000);
+}
+
+void SampleStreamer::setEnabled(bool shouldStream)
+{
+    if (shouldStream == enabled)
+        return;
+
+    stopThread(2000);
+    enabled = shouldStream;
+    ++epoch;
+
+    for (auto& stream : streams)
+    {
+        stream->ring.assign(shouldStream ? (size_t) ringFrames : 0, 0.0f);
+        stream->ring.shrink_to_fit();
+        stream->fifo.reset();
+        stream->zone = nullptr;
+
+        // A note already playing has lost its stream; only new ones get one.
+        stream->serving = stream->requested.load();
+    }
+
+    if (enabled)
+        startThread(juce::Thread::Priority::high);
+}
+
+SampleStreamer::Zone::Ptr SampleStreamer::createZone(MappedSample::Ptr sample, double preloadMs)
+{
+    Zone::Ptr zone = new Zone(std::move(sample), preloadMs);
+
+    const juce::ScopedLock sl(lock);
+
+    // The list holds the last reference to a zone nobody plays any more.
+    for (int i = zones.size(); --i >= 0;)
+        if (zones.getUnchecked(i)->getReferenceCount() == 1)
+            zones.remove(i);
+
+    zones.add(zone.get());
+    return zone;
+}
+
+void SampleStreamer::resetStatistics() noexcept
+{
+    underrunSamples.store(0, std::memory_order_relaxed);
+    lowestPrefetch.store(std::numeric_limits<int>::max(), std::memory_order_relaxed);
+}
+
+void SampleStreamer::run()
+{
+    while (! threadShouldExit())
+    {
+        {
+            const juce::ScopedLock sl(lock);
+
+            for (auto& stream : streams)
+                stream->service();
+        }
+
+        wait(pollIntervalMs);
+    }
+}
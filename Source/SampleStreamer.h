@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    SampleStreamer.h
+
+    Disk streaming for the "Sample" oscillator mode. Reading a mapped file
+    from the audio thread is zero-copy, but the first touch of every page is
+    a page fault, and on a cold multi-gigabyte library that is disk I/O in
+    the middle of a block. With streaming on, the audio thread never reads
+    the file:
+
+      - A Zone holds a sample's first preload milliseconds, decoded into
+        memory when the sample is loaded, so a note can start at once.
+      - Every voice has a Stream: a lock-free single-producer single-consumer
+        ring (juce::AbstractFifo) of decoded frames that follow the preload.
+      - The streamer's thread is the producer. It keeps each ring topped up
+        ahead of its voice's play head, taking the page faults itself.
+
+    A note-on asks for its stream with a generation count, and the reader
+    acknowledges once it has reset the ring; until then the voice plays from
+    the preload. A voice whose play head reaches frames that haven't
+    arrived yet renders silence for the rest of the block and counts the
+    missing samples as an underrun. The lowest number of frames buffered
+    ahead of any play head is kept as well, to show how close it came.
+
+    Frames are counted from the start of the note without wrapping, so a
+    looped sample keeps streaming forward; the reader maps each frame back
+    into the file.
+
+    Zones are kept in a list here, and deleted only when the list has the
+    last reference, under the same lock as the reader's passes. Neither the
+    audio thread nor the reader ever deletes one.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "MappedSample.h"
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+
+class SampleStreamer : private juce::Thread
+{
+public:
+    static constexpr int ringFrames = 1 << 14;      // per voice; about 370 ms at 44.1 kHz
+    static constexpr int maxFramesPerPass = 4096;   // per stream, so one voice can't starve the rest
+    static constexpr int pollIntervalMs = 2;
+
+    //==============================================================================
+    class Zone : public juce::ReferenceCountedObject
+    {
+    public:
+        using Ptr = juce::ReferenceCountedObjectPtr<Zone>;
+
+        Zone(MappedSample::Ptr sampleToPlay, double preloadMs);
+
+        MappedSample* getSample() const noexcept { return sample.get(); }
+        double getPreloadMs() const noexcept { return preloadMs; }
+
+        // The first getNumPreloaded() frames, mixed to mono as the sample plays them.
+        const float* getPreload() const noexcept { return preload.data(); }
+        juce::int64 getNumPreloaded() const noexcept { return (juce::int64) preload.size(); }
+
+    private:
+        const MappedSample::Ptr sample;
+        const double preloadMs;
+        std::vector<float> preload;
+
+        JUCE_DECLARE_NON_COPYABLE(Zone)
+    };
+
+    //==============================================================================
+    class Stream
+    {
+    public:
+        // What the ring holds for the audio thread: numReady frames from
+        // firstFrame on, the first of them at ring[start]. Empty until the
+        // reader has picked up the current note.
+        struct View
+        {
+            const float* ring = nullptr;
+            int start = 0;
+            int numReady = 0;
+            juce::int64 firstFrame = 0;
+
+            float operator[] (juce::int64 frame) const noexcept
+            {
+                return ring[(start + (int) (frame - firstFrame)) & (ringFrames - 1)];
+            }
+        };
+
+        explicit Stream(SampleStreamer& streamer) noexcept : owner(streamer) {}
+
+        // Audio thread. The caller keeps a reference to zone for the whole note.
+        void start(Zone* zone, bool loop) noexcept;
+        void stop() noexcept { start(nullptr, false); }
+
+        View read() noexcept;
+
+        // Frees the frames before the play head for the reader to refill.
+        void release(juce::int64 playHead) noexcept;
+
+        // Changes whenever the rings are allocated or freed; a note that
+        // started under a different one has lost its stream.
+        juce::uint32 getEpoch() const noexcept { return owner.epoch; }
+
+        void reportUnderrun(int numSamples) noexcept;
+        void reportPrefetch(juce::int64 framesAhead) noexcept;
+
+    private:
+        friend class SampleStreamer;
+
+        SampleStreamer& owner;
+        std::vector<float> ring;            // ringFrames while streaming is enabled
+        juce::AbstractFifo fifo{ ringFrames };
+
+        // The note to stream, written by the audio thread before requested
+        // is bumped.
+        std::atomic<Zone*> requestedZone{ nullptr };
+        std::atomic<bool> requestedLoop{ false };
+        std::atomic<juce::uint32> requested{ 0 };
+        std::atomic<juce::uint32> acknowledged{ 0 };
+
+        juce::int64 firstFrame = 0;         // audio thread: the frame at the fifo's read position
+
+        // Reader thread only.
+        Zone::Ptr zone;
+        bool loop = false;
+        juce::uint32 serving = 0;
+        juce::int64 nextFrame = 0;
+
+        // Reader thread: picks up a new note and tops the ring up.
+        void service();
+    };
+
+    //==============================================================================
+    explicit SampleStreamer(int numStreams);
+    ~SampleStreamer() override;
+
+    // Allocates the rings and starts the reader, or stops it and frees them.
+    // Not while the audio thread renders: from prepareToPlay, or with
+    // processing suspended.
+    void setEnabled(bool shouldStream);
+    bool isEnabled() const noexcept { return enabled; }
+
+    Stream& getStream(int index) noexcept { return *streams[(size_t) index]; }
+
+    // The zone to play sample with this much preload. Decodes the preload,
+    // so call it from the message thread.
+    Zone::Ptr createZone(MappedSample::Ptr sample, double preloadMs);
+
+    // Samples rendered as silence because a ring ran dry, and the fewest
+    // frames seen buffered ahead of a play head, since the last reset.
+    // Any thread.
+    juce::int64 getUnderrunSamples() const noexcept { return underrunSamples.load(std::memory_order_relaxed); }
+    int getLowestPrefetchFrames() const noexcept { return lowestPrefetch.load(std::memory_order_relaxed); }
+    void resetStatistics() noexcept;
+
+private:
+    std::vector<std::unique_ptr<Stream>> streams;
+    juce::ReferenceCountedArray<Zone> zones;
+    juce::CriticalSection lock;             // zones, and the reader's passes
+    bool enabled = false;
+    juce::uint32 epoch = 0;
+
+    std::atomic<juce::int64> underrunSamples{ 0 };
+    std::atomic<int> lowestPrefetch{ std::numeric_limits<int>::max() };
+
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleStreamer)
+};
@@ -0,0 +1,231 @@
+/*
+  ==============================================================================
+
+    SegmentEnvelope.h
+
+    ADSR envelope rendered a segment at a time. Whenever a stage starts, the
+    number of samples it lasts is worked out in closed form, so rendering a
+    block is a short loop over segments that each fill their run of samples
+    without any per-sample branching or end-of-stage checks.
+
+    The curves are the ones maxiEnv used: the attack rises linearly to 1,
+    decay and release fall exponentially, reaching 1% of their starting
+    level after the set time. Decay stops at the sustain level and release
+    ends the note once the level drops below silenceLevel.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "DspContext.h"
+#include <array>
+#include <cmath>
+
+class SegmentEnvelope
+{
+public:
+    // Below this the note is inaudible and the release ends.
+    static constexpr double silenceLevel = 0.0001;
+
+    SegmentEnvelope() = default;
+
+    void prepare(const DspContext& context) noexcept { samplesPerMs = context.millisecondsToSamples(1.0); }
+
+    // Times in milliseconds, sustain 0 - 1. Takes effect at the next noteOn / noteOff.
+    void setParameters(float attackMs, float decayMs, float sustainLevel, float releaseMs) noexcept
+    {
+        attackStep = 1.0 / juce::jmax(1.0, attackMs * samplesPerMs);
+        decayFactor = fallFactor(decayMs);
+        releaseFactor = fallFactor(releaseMs);
+        sustain = juce::jlimit(0.0, 1.0, (double) sustainLevel);
+    }
+
+    // The attack starts from the current level, so a retriggered voice doesn't click.
+    void noteOn() noexcept { startStage(Stage::attack); }
+
+    // Releases from wherever the envelope is, including mid-attack.
+    void noteOff() noexcept
+    {
+        if (stage != Stage::idle)
+            startStage(Stage::release);
+    }
+
+    void reset() noexcept
+    {
+        stage = Stage::idle;
+        level = 0.0;
+        samplesLeft = 0;
+    }
+
+    bool isActive() const noexcept { return stage != Stage::idle; }
+    bool isReleasing() const noexcept { return stage == Stage::release; }
+
+    // The level the next sample continues from.
+    double getValue() const noexcept { return level; }
+
+    // Fills dest with the envelope and returns how many samples were written:
+    // numSamples, or fewer if the release finished inside the block.
+    template <typename SampleType>
+    int render(SampleType* dest, int numSamples) noexcept
+    {
+        int written = 0;
+
+        while (written < numSamples && stage != Stage::idle)
+        {
+            SampleType* d = dest + written;
+
+            if (stage == Stage::sustain)
+            {
+                juce::FloatVectorOperations::fill(d, (SampleType) level, numSamples - written);
+                return numSamples;
+            }
+
+            const int count = juce::jmin(samplesLeft, numSamples - written);
+
+            if (stage == Stage::attack)
+                fillLinear(d, count);
+            else
+                fillExponential(d, count);
+
+            written += count;
+            samplesLeft -= count;
+
+            if (samplesLeft == 0)
+                finishStage();
+        }
+
+        return written;
+    }
+
+private:
+    enum class Stage { idle, attack, decay, sustain, release };
+
+    // Exponential segments are filled this many samples per serial multiply.
+    static constexpr int powersPerStep = 8;
+
+    double samplesPerMs = 44.1;
+    double attackStep = 1.0;     // per sample
+    double decayFactor = 0.99;   // per sample
+    double releaseFactor = 0.99; // per sample
+    double sustain = 1.0;
+
+    Stage stage = Stage::idle;
+    double level = 0.0;
+    int samplesLeft = 0;
+    std::array<double, powersPerStep> powers{}; // factor^1 .. factor^powersPerStep of the running segment
+
+    double fallFactor(float ms) const noexcept
+    {
+        return std::pow(0.01, 1.0 / juce::jmax(1.0, ms * samplesPerMs));
+    }
+
+    // Samples until level * factor^n first drops to target (at least one).
+    static int samplesToFall(double from, double target, double factor) noexcept
+    {
+        if (from <= target)
+            return 0;
+
+        return juce::jmax(1, (int) std::ceil(std::log(target / from) / std::log(factor)));
+    }
+
+    void startStage(Stage newStage) noexcept
+    {
+        stage = newStage;
+
+        switch (stage)
+        {
+            case Stage::attack:
+                samplesLeft = (int) std::ceil((1.0 - level) / attackStep);
+                break;
+
+            case Stage::decay:
+                samplesLeft = samplesToFall(level, juce::jmax(sustain, silenceLevel), decayFactor);
+                setPowers(decayFactor);
+                break;
+
+            case Stage::release:
+                samplesLeft = samplesToFall(level, silenceLevel, releaseFactor);
+                setPowers(releaseFactor);
+                break;
+
+            case Stage::sustain:
+            case Stage::idle:
+                samplesLeft = 0;
+                break;
+        }
+
+        // Stages that are already complete are skipped straight away.
+        if (samplesLeft <= 0 && (stage == Stage::attack || stage == Stage::decay || stage == Stage::release))
+            finishStage();
+    }
+
+    void finishStage() noexcept
+    {
+        switch (stage)
+        {
+            case Stage::attack:
+                level = 1.0;
+                startStage(Stage::decay);
+                break;
+
+            case Stage::decay:
+                level = sustain;
+                startStage(Stage::sustain);
+                break;
+
+            case Stage::release:
+                reset();
+                break;
+
+            case Stage::sustain:
+            case Stage::idle:
+                break;
+        }
+    }
+
+    void setPowers(double factor) noexcept
+    {
+        double p = 1.0;
+
+        for (auto& power : powers)
+            power = (p *= factor);
+    }
+
+    // level + step * (i + 1): independent iterations.
+    template <typename SampleType>
+    void fillLinear(SampleType* dest, int count) noexcept
+    {
+        const double start = level;
+        const double step = attackStep;
+
+        for (int i = 0; i < count; ++i)
+            dest[i] = (SampleType) juce::jmin(1.0, start + step * (double) (i + 1));
+
+        level = juce::jmin(1.0, start + step * (double) count);
+    }
+
+    // level * factor^(i + 1). Within a step the powers come from the table,
+    // so the inner loop vectorises and only one multiply per step is serial.
+    template <typename SampleType>
+    void fillExponential(SampleType* dest, int count) noexcept
+    {
+        int i = 0;
+
+        for (; i + powersPerStep <= count; i += powersPerStep)
+        {
+            for (int k = 0; k < powersPerStep; ++k)
+                dest[i + k] = (SampleType) (level * powers[(size_t) k]);
+
+            level *= powers[powersPerStep - 1];
+        }
+
+        const int rest = count - i;
+
+        for (int k = 0; k < rest; ++k)
+            dest[i + k] = (SampleType) (level * powers[(size_t) k]);
+
+        if (rest > 0)
+            level *= powers[(size_t) rest - 1];
+    }
+};
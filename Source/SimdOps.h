@@ -0,0 +1,139 @@
+/*
+  ==============================================================================
+
+    SimdOps.h
+
+    Small set of vector kernels used by the DSP code. The widest instruction
+    set the compiler is allowed to emit is picked at compile time:
+    AVX2 (when built with -mavx2 / /arch:AVX2), SSE2 (always available on
+    x86-64) or NEON (ARM), with a scalar fallback for everything else.
+
+    Every kernel has a float and a double overload, so the double precision
+    path gets the same treatment at half the lanes instead of converting.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#if defined(__AVX2__)
+ #include <immintrin.h>
+ #define SIMDOPS_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define SIMDOPS_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #include <arm_neon.h>
+ #define SIMDOPS_NEON 1
+#endif
+
+namespace SimdOps
+{
+    // Sum of a[i] * b[i] for i in [0, n). Neither pointer needs to be aligned.
+    inline float dotProduct(const float* a, const float* b, int n) noexcept
+    {
+        int i = 0;
+        float sum = 0.0f;
+
+       #if SIMDOPS_AVX2
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+
+        for (; i + 16 <= n; i += 16)
+        {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i),     _mm256_loadu_ps(b + i),     acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        }
+
+        const __m256 acc = _mm256_add_ps(acc0, acc1);
+        __m128 lanes = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        lanes = _mm_add_ps(lanes, _mm_movehl_ps(lanes, lanes));
+        lanes = _mm_add_ss(lanes, _mm_shuffle_ps(lanes, lanes, 1));
+        sum = _mm_cvtss_f32(lanes);
+       #elif SIMDOPS_SSE2
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+
+        for (; i + 8 <= n; i += 8)
+        {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i),     _mm_loadu_ps(b + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        }
+
+        __m128 lanes = _mm_add_ps(acc0, acc1);
+        lanes = _mm_add_ps(lanes, _mm_movehl_ps(lanes, lanes));
+        lanes = _mm_add_ss(lanes, _mm_shuffle_ps(lanes, lanes, 1));
+        sum = _mm_cvtss_f32(lanes);
+       #elif SIMDOPS_NEON
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+        for (; i + 8 <= n; i += 8)
+        {
+            acc0 = vmlaq_f32(acc0, vld1q_f32(a + i),     vld1q_f32(b + i));
+            acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        }
+
+        const float32x4_t acc = vaddq_f32(acc0, acc1);
+        float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+        sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+       #endif
+
+        for (; i < n; ++i)
+            sum += a[i] * b[i];
+
+        return sum;
+    }
+
+    inline double dotProduct(const double* a, const double* b, int n) noexcept
+    {
+        int i = 0;
+        double sum = 0.0;
+
+       #if SIMDOPS_AVX2
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+
+        for (; i + 8 <= n; i += 8)
+        {
+            acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i),     _mm256_loadu_pd(b + i),     acc0);
+            acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+        }
+
+        const __m256d acc = _mm256_add_pd(acc0, acc1);
+        __m128d lanes = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+        lanes = _mm_add_sd(lanes, _mm_unpackhi_pd(lanes, lanes));
+        sum = _mm_cvtsd_f64(lanes);
+       #elif SIMDOPS_SSE2
+        __m128d acc0 = _mm_setzero_pd();
+        __m128d acc1 = _mm_setzero_pd();
+
+        for (; i + 4 <= n; i += 4)
+        {
+            acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i),     _mm_loadu_pd(b + i)));
+            acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+        }
+
+        __m128d lanes = _mm_add_pd(acc0, acc1);
+        lanes = _mm_add_sd(lanes, _mm_unpackhi_pd(lanes, lanes));
+        sum = _mm_cvtsd_f64(lanes);
+       #elif SIMDOPS_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+        // 32-bit ARM NEON has no double lanes; it takes the scalar loop below.
+        float64x2_t acc0 = vdupq_n_f64(0.0);
+        float64x2_t acc1 = vdupq_n_f64(0.0);
+
+        for (; i + 4 <= n; i += 4)
+        {
+            acc0 = vfmaq_f64(acc0, vld1q_f64(a + i),     vld1q_f64(b + i));
+            acc1 = vfmaq_f64(acc1, vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+        }
+
+        sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+       #endif
+
+        for (; i < n; ++i)
+            sum += a[i] * b[i];
+
+        return sum;
+    }
+}
@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    SimpleFFT.h
+
+    In-place iterative radix-2 complex FFT with precomputed twiddles and
+    bit-reversal table. Used by the partitioned convolution in FIRFilter,
+    in whichever sample type the filter runs in.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <complex>
+#include <vector>
+#include <cmath>
+
+template <typename FloatType>
+class SimpleFFT
+{
+public:
+    using Complex = std::complex<FloatType>;
+
+    SimpleFFT() = default;
+
+    explicit SimpleFFT(int fftSize)
+        : size(fftSize),
+        twiddles(fftSize / 2),
+        bitReversed(fftSize)
+    {
+        jassert(juce::isPowerOfTwo(fftSize) && fftSize >= 2);
+
+        for (int k = 0; k < size / 2; k++)
+        {
+            const double angle = -2.0 * juce::MathConstants<double>::pi * k / size;
+            twiddles[k] = Complex((FloatType) std::cos(angle), (FloatType) std::sin(angle));
+        }
+
+        int bits = 0;
+        while ((1 << bits) < size)
+            bits++;
+
+        for (int i = 0; i < size; i++)
+        {
+            int r = 0;
+            for (int b = 0; b < bits; b++)
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+
+            bitReversed[i] = r;
+        }
+    }
+
+    int getSize() const noexcept { return size; }
+
+    void forward(Complex* data) const noexcept { transform<false>(data); }
+
+    // Unscaled: the result is size times the original signal.
+    void inverse(Complex* data) const noexcept { transform<true>(data); }
+
+private:
+    int size = 0;
+    std::vector<Complex> twiddles;
+    std::vector<int> bitReversed;
+
+    template <bool inverse>
+    void transform(Complex* data) const noexcept
+    {
+        for (int i = 0; i < size; i++)
+            if (i < bitReversed[i])
+                std::swap(data[i], data[bitReversed[i]]);
+
+        for (int half = 1, stride = size / 2; half < size; half *= 2, stride /= 2)
+        {
+            for (int start = 0; start < size; start += 2 * half)
+            {
+                for (int k = 0; k < half; k++)
+                {
+                    const Complex w = twiddles[k * stride];
+                    const FloatType wi = inverse ? -w.imag() : w.imag();
+                    const Complex x = data[start + k + half];
+
+                    // Written out by hand: std::complex operator* pulls in the
+                    // slow NaN-checking path unless fast-math is enabled.
+                    const Complex a = data[start + k];
+                    const Complex b(x.real() * w.real() - x.imag() * wi,
+                                    x.real() * wi + x.imag() * w.real());
+
+                    data[start + k] = a + b;
+                    data[start + k + half] = a - b;
+                }
+            }
+        }
+    }
+};
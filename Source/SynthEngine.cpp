@@ -0,0 +1,314 @@
+/*
+  ==============================================================================
+
+    SynthEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "SynthEngine.h"
+
+SynthEngine::SynthEngine()
+{
+    voicePool.reserve(maxVoices);
+    freeVoices.reserve(maxVoices);
+}
+
+void SynthEngine::addVoice(WavetableVoice* newVoice)
+{
+    jassert(voicePool.size() < (size_t) maxVoices);
+
+    juce::Synthesiser::addVoice(newVoice);
+
+    newVoice->engine = this;
+    voicePool.push_back(newVoice);
+    pushFree(*newVoice);
+}
+
+void SynthEngine::setVoiceOptions(const float* globalLfo, bool filterPerVoice) noexcept
+{
+    voiceLfoFloat = globalLfo;
+    voiceFilterEnabled = filterPerVoice;
+}
+
+void SynthEngine::setVoiceOptions(const double* globalLfo, bool filterPerVoice) noexcept
+{
+    voiceLfoDouble = globalLfo;
+    voiceFilterEnabled = filterPerVoice;
+}
+
+void SynthEngine::prepareRendering(int maximumBlockSize, bool doublePrecision)
+{
+    preparedBlockSize = maximumBlockSize;
+    preparedDouble = doublePrecision;
+
+    bank.prepare(maximumBlockSize, doublePrecision);
+
+    // The slots depend on the block size and precision.
+    if (renderPool != nullptr)
+        allocateVoiceSlots();
+}
+
+void SynthEngine::setMultiCoreRendering(bool shouldUseWorkers)
+{
+    if (!shouldUseWorkers)
+    {
+        renderPool.reset();
+        voiceSlots.setSize(0, 0);
+        voiceSlotsDouble.setSize(0, 0);
+        return;
+    }
+
+    if (renderPool != nullptr)
+        return;
+
+    const int numWorkers = juce::jlimit(0, 7, juce::SystemStats::getNumCpus() - 1);
+
+    if (numWorkers == 0)
+        return;
+
+    allocateVoiceSlots();
+    renderPool = std::make_unique<VoiceRenderPool>(numWorkers, [this](int index) { renderJob(index); });
+}
+
+void SynthEngine::allocateVoiceSlots()
+{
+    // Only the precision in use needs slots; 256 voices of the other would be wasted.
+    if (preparedDouble)
+    {
+        voiceSlotsDouble.setSize(2 * maxVoices, preparedBlockSize);
+        voiceSlots.setSize(0, 0);
+    }
+    else
+    {
+        voiceSlots.setSize(2 * maxVoices, preparedBlockSize);
+        voiceSlotsDouble.setSize(0, 0);
+    }
+}
+
+//==============================================================================
+void SynthEngine::voiceStarted(WavetableVoice& voice) noexcept
+{
+    // A stolen voice is already in the list; move it to the back so the
+    // list stays ordered by note-on time.
+    if (voice.isInActiveList)
+        unlinkActive(voice);
+    else
+        removeFree(voice);
+
+    voice.previousActive = activeTail;
+    voice.nextActive = nullptr;
+
+    if (activeTail != nullptr)
+        activeTail->nextActive = &voice;
+    else
+        activeHead = &voice;
+
+    activeTail = &voice;
+    voice.isInActiveList = true;
+    ++numActive;
+}
+
+void SynthEngine::unlinkActive(WavetableVoice& voice) noexcept
+{
+    jassert(voice.isInActiveList);
+
+    if (voice.previousActive != nullptr)
+        voice.previousActive->nextActive = voice.nextActive;
+    else
+        activeHead = voice.nextActive;
+
+    if (voice.nextActive != nullptr)
+        voice.nextActive->previousActive = voice.previousActive;
+    else
+        activeTail = voice.previousActive;
+
+    voice.previousActive = voice.nextActive = nullptr;
+    voice.isInActiveList = false;
+    --numActive;
+}
+
+void SynthEngine::pushFree(WavetableVoice& voice) noexcept
+{
+    voice.freeIndex = (int) freeVoices.size();
+    freeVoices.push_back(&voice); // never reallocates: reserved for maxVoices
+}
+
+void SynthEngine::removeFree(WavetableVoice& voice) noexcept
+{
+    jassert(voice.freeIndex >= 0);
+
+    auto* last = freeVoices.back();
+    freeVoices[(size_t) voice.freeIndex] = last;
+    last->freeIndex = voice.freeIndex;
+    freeVoices.pop_back();
+
+    voice.freeIndex = -1;
+}
+
+//==============================================================================
+void SynthEngine::renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+{
+    renderActiveVoices(outputAudio, startSample, numSamples);
+}
+
+void SynthEngine::renderVoices(juce::AudioBuffer<double>& outputAudio, int startSample, int numSamples)
+{
+    renderActiveVoices(outputAudio, startSample, numSamples);
+}
+
+template <typename SampleType>
+void SynthEngine::prepareVoices(int numSamples) noexcept
+{
+    constexpr bool doublePrecision = std::is_same_v<SampleType, double>;
+    int numBankable = 0;
+
+    for (auto* voice = activeHead; voice != nullptr; voice = voice->nextActive)
+    {
+        if (voice->isVoiceActive())
+        {
+            voice->setGlobalLfo(getVoiceLfo<SampleType>());
+            voice->setFilterEnabled(voiceFilterEnabled);
+
+            if (voice->canRenderInBank(doublePrecision))
+                ++numBankable;
+        }
+    }
+
+    if (numBankable < minVoicesForBank || numSamples > bank.getMaximumBlockSize())
+        return;
+
+    for (auto* voice = activeHead; voice != nullptr; voice = voice->nextActive)
+        if (voice->isVoiceActive() && voice->canRenderInBank(doublePrecision))
+            bank.add(*voice, doublePrecision);
+}
+
+template <typename SampleType>
+void SynthEngine::renderActiveVoices(juce::AudioBuffer<SampleType>& outputAudio, int startSample, int numSamples)
+{
+    prepareVoices<SampleType>(numSamples);
+
+    if (renderPool != nullptr && numActive >= minVoicesForWorkers
+        && numSamples <= getVoiceSlots<SampleType>().getNumSamples())
+    {
+        renderVoicesInParallel(outputAudio, startSample, numSamples);
+    }
+    else
+    {
+        for (int chunk = 0; chunk < bank.getNumChunks(); ++chunk)
+            bank.renderChunk(chunk, startSample, numSamples, std::is_same_v<SampleType, double>);
+
+        bank.addTo(outputAudio, startSample, numSamples, getVoiceLfo<SampleType>());
+
+        for (auto* voice = activeHead; voice != nullptr; voice = voice->nextActive)
+            if (voice->isVoiceActive() && !voice->inVoiceBank)
+                voice->renderNextBlock(outputAudio, startSample, numSamples);
+    }
+
+    bank.clear();
+
+    // Voices that finished (or were cut) go back on the free stack.
+    for (auto* voice = activeHead; voice != nullptr;)
+    {
+        auto* next = voice->nextActive;
+
+        if (!voice->isVoiceActive())
+        {
+            unlinkActive(*voice);
+            pushFree(*voice);
+        }
+
+        voice = next;
+    }
+}
+
+template <typename SampleType>
+void SynthEngine::renderVoicesInParallel(juce::AudioBuffer<SampleType>& outputAudio, int startSample, int numSamples)
+{
+    auto& slots = getVoiceSlots<SampleType>();
+    int numJobs = 0;
+
+    for (auto* voice = activeHead; voice != nullptr; voice = voice->nextActive)
+        if (voice->isVoiceActive() && !voice->inVoiceBank)
+            jobVoices[(size_t) numJobs++] = voice;
+
+    numBankJobs = bank.getNumChunks();
+    jobStartSample = startSample;
+    jobNumSamples = numSamples;
+    jobsAreDouble = std::is_same_v<SampleType, double>;
+
+    renderPool->run(numBankJobs + numJobs);
+
+    bank.addTo(outputAudio, startSample, numSamples, getVoiceLfo<SampleType>());
+
+    for (int i = 0; i < numJobs; ++i)
+    {
+        const bool stereo = jobVoices[(size_t) i]->isStereo();
+
+        for (int ch = outputAudio.getNumChannels(); --ch >= 0;)
+        {
+            const int slot = 2 * i + ((stereo && (ch & 1) != 0) ? 1 : 0);
+            juce::FloatVectorOperations::add(outputAudio.getWritePointer(ch, startSample),
+                                             slots.getReadPointer(slot), jobLengths[(size_t) i]);
+        }
+    }
+}
+
+void SynthEngine::renderJob(int index) noexcept
+{
+    if (index < numBankJobs)
+    {
+        bank.renderChunk(index, jobStartSample, jobNumSamples, jobsAreDouble);
+        return;
+    }
+
+    index -= numBankJobs;
+    auto* voice = jobVoices[(size_t) index];
+
+    jobLengths[(size_t) index] = jobsAreDouble
+        ? voice->renderToSlots(voiceSlotsDouble.getWritePointer(2 * index), voiceSlotsDouble.getWritePointer(2 * index + 1),
+                               jobStartSample, jobNumSamples)
+        : voice->renderToSlots(voiceSlots.getWritePointer(2 * index), voiceSlots.getWritePointer(2 * index + 1),
+                               jobStartSample, jobNumSamples);
+}
+
+juce::SynthesiserVoice* SynthEngine::findFreeVoice(juce::SynthesiserSound* soundToPlay, int midiChannel,
+                                                   int midiNoteNumber, bool stealIfNoneAvailable) const
+{
+    if (numActive < polyphony && !freeVoices.empty())
+        return freeVoices.back();
+
+    if (stealIfNoneAvailable)
+        return findVoiceToSteal(soundToPlay, midiChannel, midiNoteNumber);
+
+    return nullptr;
+}
+
+juce::SynthesiserVoice* SynthEngine::findVoiceToSteal(juce::SynthesiserSound*, int, int) const
+{
+    switch (stealingPolicy)
+    {
+        case StealingPolicy::releasedFirst:
+            for (auto* voice = activeHead; voice != nullptr; voice = voice->nextActive)
+                if (voice->isPlayingButReleased())
+                    return voice;
+
+            return activeHead;
+
+        case StealingPolicy::oldest:
+            return activeHead;
+
+        case StealingPolicy::quietest:
+        {
+            WavetableVoice* quietest = activeHead;
+
+            for (auto* voice = activeHead; voice != nullptr; voice = voice->nextActive)
+                if (voice->getCurrentLevel() < quietest->getCurrentLevel())
+                    quietest = voice;
+
+            return quietest;
+        }
+    }
+
+    return activeHead;
+}
@@ -0,0 +1,167 @@
+/*
+  ==============================================================================
+
+    SynthEngine.h
+
+    juce::Synthesiser with a fixed pool of WavetableVoices. Sounding voices
+    are kept in an intrusive list in note-on order, and idle voices sit on a
+    free stack, so rendering and allocation never have to walk the whole pool:
+    idle voices cost nothing per block no matter how many there are.
+
+    The polyphony parameter caps how many voices may sound at once. Past that
+    cap a voice is stolen according to the selected StealingPolicy.
+
+    With multi-core rendering on, the sounding voices of a block are rendered
+    by a VoiceRenderPool into a pair of slots each (the second one is only
+    used when pan is modulated), and the slots are then added to the output
+    in list order. That is the same sequence of additions the
+    single-threaded path does, so both paths produce bit-identical output.
+
+    Voices that are a plain oscillator (see WavetableVoice::canRenderInBank)
+    are taken out of that and rendered together by a VoiceBank, a lane per
+    voice, once there are enough of them to fill its lanes. The bank's mix is
+    added first, then the remaining voices; with multi-core rendering its
+    chunks are jobs alongside theirs.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "WavetableVoice.h"
+#include "VoiceRenderPool.h"
+#include "VoiceBank.h"
+#include <array>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+class SynthEngine : public juce::Synthesiser
+{
+public:
+    static constexpr int maxVoices = 256;
+
+    enum class StealingPolicy
+    {
+        releasedFirst = 0, // oldest voice whose key is up, else the oldest
+        oldest,
+        quietest
+    };
+
+    SynthEngine();
+
+    // Hides Synthesiser::addVoice so every voice in the pool is a WavetableVoice.
+    void addVoice(WavetableVoice* newVoice);
+
+    const std::vector<WavetableVoice*>& getWavetableVoices() const noexcept { return voicePool; }
+
+    void setPolyphony(int numVoices) noexcept { polyphony = juce::jlimit(1, (int) voicePool.size(), numVoices); }
+    void setStealingPolicy(StealingPolicy newPolicy) noexcept { stealingPolicy = newPolicy; }
+
+    // Per-block voice state, handed to each sounding voice before it renders.
+    // The LFO is in the same precision as the buffer being rendered.
+    void setVoiceOptions(const float* globalLfo, bool filterPerVoice) noexcept;
+    void setVoiceOptions(const double* globalLfo, bool filterPerVoice) noexcept;
+
+    // Sizes the voice bank for the block size and precision the host will
+    // render in. Not realtime safe.
+    void prepareRendering(int maximumBlockSize, bool doublePrecision);
+
+    // Starts the worker threads and allocates the voice slots they render
+    // into, or stops and frees them. Idle workers still spin and yield
+    // between blocks, so they only exist while the option is on. Not
+    // realtime safe; call it between prepareRendering and rendering, or
+    // with processing suspended.
+    void setMultiCoreRendering(bool shouldUseWorkers);
+    bool isMultiCoreRendering() const noexcept { return renderPool != nullptr; }
+
+    int getNumActiveVoices() const noexcept { return numActive; }
+
+    // True when no voice has sounded since the last render removed the
+    // finished ones. Kept up to date by voiceStarted and the render loop.
+    bool isSilent() const noexcept { return numActive == 0; }
+
+    // Called by WavetableVoice::startNote, for fresh and stolen voices alike.
+    void voiceStarted(WavetableVoice& voice) noexcept;
+
+protected:
+    void renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) override;
+    void renderVoices(juce::AudioBuffer<double>& outputAudio, int startSample, int numSamples) override;
+
+    juce::SynthesiserVoice* findFreeVoice(juce::SynthesiserSound* soundToPlay, int midiChannel,
+                                          int midiNoteNumber, bool stealIfNoneAvailable) const override;
+
+    juce::SynthesiserVoice* findVoiceToSteal(juce::SynthesiserSound* soundToPlay, int midiChannel,
+                                             int midiNoteNumber) const override;
+
+private:
+    std::vector<WavetableVoice*> voicePool;  // owned by Synthesiser::voices
+    std::vector<WavetableVoice*> freeVoices; // idle voices, used as a stack
+
+    WavetableVoice* activeHead = nullptr;    // oldest sounding voice
+    WavetableVoice* activeTail = nullptr;    // newest sounding voice
+    int numActive = 0;
+
+    int polyphony = maxVoices;
+    StealingPolicy stealingPolicy = StealingPolicy::releasedFirst;
+
+    const float* voiceLfoFloat = nullptr;
+    const double* voiceLfoDouble = nullptr;
+    bool voiceFilterEnabled = false;
+
+    // Below this many sounding voices waking the workers costs more than it saves.
+    static constexpr int minVoicesForWorkers = 4;
+
+    // Below this many the bank's padding lanes cost more than one voice at a time.
+    static constexpr int minVoicesForBank = VoiceBank::laneWidth / 2;
+
+    VoiceBank bank;
+
+    std::unique_ptr<VoiceRenderPool> renderPool;      // only while multi-core rendering is on
+    int preparedBlockSize = 0;
+    bool preparedDouble = false;
+    juce::AudioBuffer<float> voiceSlots;              // two channels per job, float hosts
+    juce::AudioBuffer<double> voiceSlotsDouble;       // the same, double precision hosts
+    std::array<WavetableVoice*, maxVoices> jobVoices{}; // sounding voices in list order
+    std::array<int, maxVoices> jobLengths{};
+    int numBankJobs = 0;                          // the bank's chunks come first
+    int jobStartSample = 0, jobNumSamples = 0;
+    bool jobsAreDouble = false;
+
+    template <typename SampleType>
+    juce::AudioBuffer<SampleType>& getVoiceSlots() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return voiceSlotsDouble;
+        else
+            return voiceSlots;
+    }
+
+    template <typename SampleType>
+    const SampleType* getVoiceLfo() const noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return voiceLfoDouble;
+        else
+            return voiceLfoFloat;
+    }
+
+    // Hands the block's options to the sounding voices, and those that can
+    // go in the bank to the bank if there are enough of them.
+    template <typename SampleType>
+    void prepareVoices(int numSamples) noexcept;
+
+    template <typename SampleType>
+    void renderActiveVoices(juce::AudioBuffer<SampleType>& outputAudio, int startSample, int numSamples);
+
+    template <typename SampleType>
+    void renderVoicesInParallel(juce::AudioBuffer<SampleType>& outputAudio, int startSample, int numSamples);
+    void renderJob(int index) noexcept;
+    void allocateVoiceSlots();
+
+    void unlinkActive(WavetableVoice& voice) noexcept;
+    void pushFree(WavetableVoice& voice) noexcept;
+    void removeFree(WavetableVoice& voice) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SynthEngine)
+};
@@ -0,0 +1,74 @@
+/*
+  ==============================================================================
+
+    UnisonOscillator.cpp
+
+  ==============================================================================
+*/
+
+#include "UnisonOscillator.h"
+
+void UnisonOscillator::setFrequency(double hz, const DspContext& context) noexcept
+{
+    baseIncrement = context.oscillatorIncrement(hz);
+    updateLanes();
+}
+
+void UnisonOscillator::setStack(int newNumLanes, float detuneCents, float newSpread) noexcept
+{
+    newNumLanes = juce::jlimit(1, maxLanes, newNumLanes);
+    newSpread = juce::jlimit(0.0f, 1.0f, newSpread);
+
+    if (newNumLanes == numLanes && detuneCents == detune && newSpread == spread)
+        return;
+
+    numLanes = newNumLanes;
+    detune = detuneCents;
+    spread = newSpread;
+    updateLanes();
+}
+
+void UnisonOscillator::reset() noexcept
+{
+    // Golden-ratio steps never line two lanes up.
+    for (int l = 0; l < maxLanes; ++l)
+    {
+        const double phase = l * 0.6180339887498949;
+        phases[(size_t) l] = phase - std::floor(phase);
+    }
+}
+
+void UnisonOscillator::updateLanes() noexcept
+{
+    numPaddedLanes = (numLanes + laneWidth - 1) / laneWidth * laneWidth;
+    stereo = numLanes > 1 && spread > 0.0f;
+
+    // Uncorrelated lanes add in power, so this keeps the stack about as loud
+    // as a single oscillator.
+    const float norm = 1.0f / std::sqrt((float) numLanes);
+    maxIncrement = 0.0;
+
+    for (int l = 0; l < maxLanes; ++l)
+    {
+        const auto lane = (size_t) l;
+
+        if (l >= numLanes)
+        {
+            increments[lane] = 0.0;
+            gainsLeft[lane] = gainsRight[lane] = 0.0f;
+            continue;
+        }
+
+        // Evenly spaced from -1 to +1 across the stack.
+        const float position = numLanes > 1 ? 2.0f * (float) l / (float) (numLanes - 1) - 1.0f : 0.0f;
+
+        increments[lane] = baseIncrement * std::exp2((double) (position * detune) / 1200.0);
+        maxIncrement = juce::jmax(maxIncrement, increments[lane]);
+
+        // Same balance law as pan modulation; neighbouring pitches go to
+        // opposite sides so the stack doesn't sweep from left to right.
+        const float pan = spread * position * ((l & 1) != 0 ? -1.0f : 1.0f);
+        gainsLeft[lane] = norm * (stereo ? 1.0f - pan : 1.0f);
+        gainsRight[lane] = norm * (stereo ? 1.0f + pan : 1.0f);
+    }
+}
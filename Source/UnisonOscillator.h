@@ -0,0 +1,201 @@
+/*
+  ==============================================================================
+
+    UnisonOscillator.h
+
+    A stack of up to maxLanes detuned copies of the wavetable oscillator,
+    playing one note inside one voice and mixed to one or two channels
+    before the voice's filter, so a supersaw costs one filter per channel
+    however many oscillators are in it.
+
+    The stack is stored as structure-of-arrays: phases, increments and the
+    left / right gains each have their own lane array, padded with silent
+    lanes to a multiple of laneWidth. For every sample the inner loop runs
+    over a fixed-size group of lanes with no dependency between them, so a
+    group is computed in SIMD registers; the per-lane sums are folded into
+    the channel outputs once per sample.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "WavetableOscillator.h"
+#include <array>
+
+class UnisonOscillator
+{
+public:
+    static constexpr int maxLanes = 16;
+    static constexpr int laneWidth = 8;
+
+    UnisonOscillator() = default;
+
+    // Base pitch of the stack. Call at note-on.
+    void setFrequency(double hz, const DspContext& context) noexcept;
+
+    // numLanes 1 - maxLanes. The outermost lanes sit detuneCents either side
+    // of the note; spread 0 - 1 pans them apart, alternating sides. Only does
+    // work when something changed, so it can be called every block.
+    void setStack(int numLanes, float detuneCents, float spread) noexcept;
+
+    // Starts the lanes at spread-out phases so a new note doesn't begin with
+    // every lane peaking together.
+    void reset() noexcept;
+
+    int getNumLanes() const noexcept { return numLanes; }
+
+    // More than one lane and a non-zero spread: the two channels differ.
+    bool isStereo() const noexcept { return stereo; }
+
+    // Renders numSamples into left (and right when stereoOut). With pitchOn,
+    // ratio[i] multiplies the whole stack's frequency at sample i, as in
+    // WavetableOscillator's modulated render.
+    template <typename SampleType, bool stereoOut, bool pitchOn>
+    void render(WaveFormSettings::WaveForms wave, SampleType* left, SampleType* right,
+                int numSamples, const SampleType* ratio) noexcept
+    {
+        const float* table = tables->get(wave, blockLevel<SampleType, pitchOn>(ratio, numSamples));
+        renderLanes<SampleType, stereoOut, pitchOn, false>(table, table, 0, left, right, numSamples, ratio);
+    }
+
+    // The same for two sets of mip levels crossfaded by mix, as in
+    // WavetableOscillator: every lane plays both.
+    template <typename SampleType, bool stereoOut, bool pitchOn>
+    void render(const float* mipsA, const float* mipsB, SampleType mix, SampleType* left, SampleType* right,
+                int numSamples, const SampleType* ratio) noexcept
+    {
+        const int level = blockLevel<SampleType, pitchOn>(ratio, numSamples);
+
+        renderLanes<SampleType, stereoOut, pitchOn, true>(WavetableOscillator::mipLevel(mipsA, level),
+                                                          WavetableOscillator::mipLevel(mipsB, level),
+                                                          mix, left, right, numSamples, ratio);
+    }
+
+private:
+    juce::SharedResourcePointer<WavetableOscillator::Tables> tables;
+
+    // Lanes numLanes .. numPaddedLanes have zero increment and gain.
+    std::array<double, maxLanes> phases{};      // 0..1
+    std::array<double, maxLanes> increments{};  // cycles per sample
+    std::array<float, maxLanes> gainsLeft{};
+    std::array<float, maxLanes> gainsRight{};
+
+    double baseIncrement = 0.0;
+    double maxIncrement = 0.0;
+    int numLanes = 1;
+    int numPaddedLanes = laneWidth;
+    float detune = 0.0f;
+    float spread = 0.0f;
+    bool stereo = false;
+
+    void updateLanes() noexcept;
+
+    // The mip level has to suit the sharpest lane at the highest pitch in the block.
+    template <typename SampleType, bool pitchOn>
+    int blockLevel(const SampleType* ratio, int numSamples) const noexcept
+    {
+        double maxRatio = 1.0;
+
+        if constexpr (pitchOn)
+        {
+            SampleType highest = 0;
+
+            for (int i = 0; i < numSamples; ++i)
+                highest = juce::jmax(highest, ratio[i]);
+
+            maxRatio = (double) highest;
+        }
+
+        return WavetableOscillator::levelFor(maxIncrement * maxRatio);
+    }
+
+    // Without morph only tableA is read.
+    template <typename SampleType, bool stereoOut, bool pitchOn, bool morph>
+    void renderLanes(const float* tableA, const float* tableB, SampleType mix, SampleType* left, SampleType* right,
+                     int numSamples, const SampleType* ratio) noexcept
+    {
+        alignas(32) std::array<SampleType, maxLanes> start, increment, gainLeft, gainRight;
+
+        for (int l = 0; l < numPaddedLanes; ++l)
+        {
+            start[(size_t) l] = (SampleType) phases[(size_t) l];
+            increment[(size_t) l] = (SampleType) increments[(size_t) l];
+            gainLeft[(size_t) l] = (SampleType) gainsLeft[(size_t) l];
+            gainRight[(size_t) l] = (SampleType) gainsRight[(size_t) l];
+        }
+
+        // How far the base phase has moved at each sample, in base increments.
+        // For a modulated pitch that is a running sum, kept in left until the
+        // sample is rendered over it.
+        SampleType travelled = (SampleType) numSamples;
+
+        if constexpr (pitchOn)
+        {
+            travelled = 0;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                left[i] = travelled;
+                travelled += ratio[i];
+            }
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const SampleType t = pitchOn ? left[i] : (SampleType) i;
+            std::array<SampleType, laneWidth> sumLeft{}, sumRight{};
+
+            for (int group = 0; group < numPaddedLanes; group += laneWidth)
+            {
+                for (int k = 0; k < laneWidth; ++k)
+                {
+                    const auto l = (size_t) (group + k);
+
+                    SampleType p = start[l] + t * increment[l];
+                    p -= (SampleType) (int) p;
+
+                    const SampleType position = p * (SampleType) WavetableOscillator::tableSize;
+                    const int index = (int) position;
+                    const SampleType frac = position - (SampleType) index;
+                    const SampleType a = tableA[index];
+                    SampleType value = a + frac * (tableA[index + 1] - a);
+
+                    if constexpr (morph)
+                    {
+                        const SampleType b = tableB[index];
+                        value += mix * (b + frac * (tableB[index + 1] - b) - value);
+                    }
+
+                    sumLeft[(size_t) k] += value * gainLeft[l];
+
+                    if constexpr (stereoOut)
+                        sumRight[(size_t) k] += value * gainRight[l];
+                }
+            }
+
+            left[i] = foldLanes(sumLeft);
+
+            if constexpr (stereoOut)
+                right[i] = foldLanes(sumRight);
+        }
+
+        for (int l = 0; l < numLanes; ++l)
+        {
+            auto& phase = phases[(size_t) l];
+            phase += (double) travelled * increments[(size_t) l];
+            phase -= std::floor(phase);
+        }
+    }
+
+    // Pairwise sum of one sample's lane group; each step is a vector add.
+    template <typename SampleType>
+    static SampleType foldLanes(std::array<SampleType, laneWidth>& sums) noexcept
+    {
+        for (int width = laneWidth / 2; width > 0; width /= 2)
+            for (int k = 0; k < width; ++k)
+                sums[(size_t) k] += sums[(size_t) (k + width)];
+
+        return sums[0];
+    }
+};
@@ -0,0 +1,242 @@
+/*
+  ==============================================================================
+
+    UserWavetables.cpp
+
+  ==============================================================================
+*/
+
+#include "UserWavetables.h"
+#include "SimpleFFT.h"
+#include <cmath>
+
+namespace
+{
+    using Complex = SimpleFFT<float>::Complex;
+
+    constexpr int tableSize = WavetableOscillator::tableSize;
+
+    template <MappedSample::Encodings encoding>
+    void decode(const MappedSample& sample, float* dest, int numFrames) noexcept
+    {
+        for (int i = 0; i < numFrames; ++i)
+            dest[i] = sample.getFrame<encoding>(i);
+    }
+
+    void decode(const MappedSample& sample, float* dest, int numFrames) noexcept
+    {
+        using Encodings = MappedSample::Encodings;
+
+        switch (sample.getEncoding())
+        {
+            case Encodings::int16: decode<Encodings::int16>(sample, dest, numFrames); break;
+            case Encodings::int24: decode<Encodings::int24>(sample, dest, numFrames); break;
+            case Encodings::int32: decode<Encodings::int32>(sample, dest, numFrames); break;
+        }
+    }
+
+    // The spectrum of one cycle, scaled as the FFT of a tableSize cycle
+    // would be. A cycle of any other length has its harmonics up to the
+    // richest mip level's worked out directly, with a rotating phasor.
+    void spectrumOf(const float* cycle, int length, const SimpleFFT<float>& fft, Complex* spectrum)
+    {
+        if (length == tableSize)
+        {
+            for (int i = 0; i < tableSize; ++i)
+                spectrum[i] = Complex(cycle[i], 0.0f);
+
+            fft.forward(spectrum);
+            return;
+        }
+
+        std::fill(spectrum, spectrum + tableSize, Complex());
+
+        const int numHarmonics = juce::jmin(WavetableOscillator::maxHarmonics, (length - 1) / 2);
+        const double scale = (double) tableSize / (double) length;
+
+        for (int k = 1; k <= numHarmonics; ++k)
+        {
+            const double angle = -2.0 * juce::MathConstants<double>::pi * k / length;
+            const std::complex<double> rotation(std::cos(angle), std::sin(angle));
+            std::complex<double> phasor(1.0, 0.0), sum;
+
+            for (int n = 0; n < length; ++n)
+            {
+                sum += (double) cycle[n] * phasor;
+                phasor *= rotation;
+            }
+
+            spectrum[k] = Complex((float) (sum.real() * scale), (float) (sum.imag() * scale));
+        }
+    }
+}
+
+//==============================================================================
+UserWavetables::Table::Table(const MappedSample& source)
+{
+    constexpr int numLevels = WavetableOscillator::numLevels;
+    constexpr int stride = WavetableOscillator::tableStride;
+
+    const juce::int64 length = source.getNumFrames();
+    const bool multiFrame = length % tableSize == 0;
+    const auto maxLength = (juce::int64) tableSize * maxFrames;
+
+    numFrames = multiFrame ? (int) juce::jmin(length / tableSize, (juce::int64) maxFrames) : 1;
+
+    const int cycleLength = multiFrame ? tableSize : (int) juce::jmin(length, maxLength);
+    std::vector<float> cycles((size_t) (multiFrame ? numFrames * tableSize : cycleLength));
+    decode(source, cycles.data(), (int) cycles.size());
+
+    data.assign((size_t) numFrames * numLevels * stride, 0.0f);
+
+    SimpleFFT<float> fft(tableSize);
+    std::vector<Complex> spectrum((size_t) tableSize), level((size_t) tableSize);
+    float peak = 0.0f;
+
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        spectrumOf(cycles.data() + (size_t) frame * cycleLength, cycleLength, fft, spectrum.data());
+
+        for (int l = 0; l < numLevels; ++l)
+        {
+            // The harmonics the level allows, without DC, mirrored so the
+            // inverse transform comes out real.
+            std::fill(level.begin(), level.end(), Complex());
+
+            for (int k = 1; k <= (WavetableOscillator::maxHarmonics >> l); ++k)
+            {
+                level[(size_t) k] = spectrum[(size_t) k];
+                level[(size_t) (tableSize - k)] = std::conj(spectrum[(size_t) k]);
+            }
+
+            fft.inverse(level.data());
+
+            float* table = data.data() + ((size_t) frame * numLevels + (size_t) l) * stride;
+
+            for (int i = 0; i < tableSize; ++i)
+                table[i] = level[(size_t) i].real() / (float) tableSize;
+
+            for (int i = 0; i < WavetableOscillator::numGuardSamples; ++i)
+                table[tableSize + i] = table[i];
+
+            if (l == 0)
+                for (int i = 0; i < tableSize; ++i)
+                    peak = juce::jmax(peak, std::abs(table[i]));
+        }
+    }
+
+    // Whatever level the file was recorded at, the table plays as loud as
+    // the built-in shapes.
+    if (peak > 0.0f)
+        juce::FloatVectorOperations::multiply(data.data(), 1.0f / peak, (int) data.size());
+}
+
+//==============================================================================
+UserWavetables::UserWavetables()
+    : juce::Thread("User wavetables")
+{
+    startThread(juce::Thread::Priority::low);
+}
+
+UserWavetables::~UserWavetables()
+{
+    stopThread(4000);
+
+    for (auto& p : pending)
+        if (auto* table = p.exchange(nullptr))
+            table->decReferenceCount();
+}
+
+void UserWavetables::load(int slot, MappedSample::Ptr source)
+{
+    files[(size_t) slot] = source->getFile();
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        if (requests[(size_t) slot] == nullptr)
+            ++numOutstanding;
+
+        requests[(size_t) slot] = std::move(source);
+    }
+
+    notify();
+}
+
+void UserWavetables::update() noexcept
+{
+    // The hand-off reference becomes playing's. The list still holds the
+    // one the previous table had, so dropping it here never frees it.
+    for (size_t slot = 0; slot < (size_t) numSlots; ++slot)
+    {
+        if (auto* next = pending[slot].exchange(nullptr, std::memory_order_acq_rel))
+        {
+            playing[slot] = next;
+            next->decReferenceCountWithoutDeleting();
+        }
+    }
+}
+
+void UserWavetables::publish(int slot, Table::Ptr table)
+{
+    {
+        const juce::ScopedLock sl(lock);
+
+        // The list holds the last reference to a table no slot plays any more.
+        for (int i = tables.size(); --i >= 0;)
+            if (tables.getUnchecked(i)->getReferenceCount() == 1)
+                tables.remove(i);
+
+        tables.add(table.get());
+    }
+
+    // The pointer in pending carries a reference of its own; one the audio
+    // thread never picked up is dropped here.
+    table->incReferenceCount();
+
+    if (auto* superseded = pending[(size_t) slot].exchange(table.get(), std::memory_order_acq_rel))
+        superseded->decReferenceCount();
+}
+
+void UserWavetables::run()
+{
+    while (! threadShouldExit())
+    {
+        int slot = -1;
+        MappedSample::Ptr source;
+
+        {
+            const juce::ScopedLock sl(lock);
+
+            for (int s = 0; s < numSlots && source == nullptr; ++s)
+            {
+                if (requests[(size_t) s] != nullptr)
+                {
+                    slot = s;
+                    source = std::move(requests[(size_t) s]);
+                    requests[(size_t) s] = nullptr;
+                }
+            }
+        }
+
+        if (source == nullptr)
+        {
+            wait(-1);
+            continue;
+        }
+
+        Table::Ptr table = new Table(*source);
+        bool superseded;
+
+        {
+            const juce::ScopedLock sl(lock);
+            superseded = requests[(size_t) slot] != nullptr;
+        }
+
+        // A newer file for the slot is waiting; it will be published instead.
+        if (! superseded)
+            publish(slot, table);
+
+        --numOutstanding;
+    }
+}
@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    UserWavetables.h
+
+    Wavetables loaded from WAV files into the "User" slots of the wave
+    choice. A file whose length is a whole number of
+    WavetableOscillator::tableSize frames is a multi-frame table, one cycle
+    per tableSize frames, up to maxFrames of them; any other length is a
+    single cycle.
+
+    Every frame gets the same mip levels as the built-in shapes, so notes
+    pick a level exactly as WavetableOscillator does. Levels are made by
+    taking the cycle's spectrum, keeping the harmonics a level allows and
+    transforming back, which for a 256-frame table is a few thousand FFTs.
+    That runs on this object's own low-priority thread, never the audio
+    thread.
+
+    A finished table is published to the audio thread through an atomic
+    pointer, and it takes the table over at the start of its next block
+    with update(). The list here keeps every table alive, and a table is
+    only deleted once the list has the last reference, by the builder. So
+    loading, replacing or dropping even a large table costs the audio thread
+    an exchange per slot and nothing more.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "MappedSample.h"
+#include "WavetableOscillator.h"
+#include <array>
+#include <atomic>
+#include <vector>
+
+class UserWavetables : private juce::Thread
+{
+public:
+    static constexpr int numSlots = 4;
+    static constexpr int maxFrames = 256;
+
+    //==============================================================================
+    class Table : public juce::ReferenceCountedObject
+    {
+    public:
+        using Ptr = juce::ReferenceCountedObjectPtr<Table>;
+
+        // Reads and transforms the whole file, so only on the builder thread.
+        explicit Table(const MappedSample& source);
+
+        int getNumFrames() const noexcept { return numFrames; }
+
+        // The mip levels of frame, laid out as WavetableOscillator::Tables
+        // lays out a wave's, so mipLevel() finds each one.
+        const float* getFrame(int frame) const noexcept
+        {
+            return data.data() + (size_t) frame * WavetableOscillator::numLevels * WavetableOscillator::tableStride;
+        }
+
+        // The frame at or before position (0 - 1 across the table) and how
+        // far it is from there to the next frame, 0 - 1.
+        int findFrame(float position, float& mix) const noexcept
+        {
+            const float frame = juce::jlimit(0.0f, 1.0f, position) * (float) (numFrames - 1);
+            const int first = juce::jmin((int) frame, juce::jmax(0, numFrames - 2));
+
+            mix = frame - (float) first;
+            return first;
+        }
+
+    private:
+        std::vector<float> data;
+        int numFrames = 1;
+
+        JUCE_DECLARE_NON_COPYABLE(Table)
+    };
+
+    //==============================================================================
+    UserWavetables();
+    ~UserWavetables() override;
+
+    // Builds a table from source for slot and publishes it when done; a
+    // newer load into the same slot supersedes one still waiting. Message
+    // thread.
+    void load(int slot, MappedSample::Ptr source);
+    juce::File getFile(int slot) const { return files[(size_t) slot]; }
+
+    // A requested table hasn't been published yet. Any thread.
+    bool isBuilding() const noexcept { return numOutstanding.load() > 0; }
+
+    // Audio thread, at the start of a block: takes over the tables finished
+    // since the last call.
+    void update() noexcept;
+
+    // Audio thread: the table in slot, or nullptr while nothing has been
+    // built for it.
+    const Table* get(int slot) const noexcept { return playing[(size_t) slot].get(); }
+
+private:
+    juce::CriticalSection lock;                                 // requests and tables
+    std::array<MappedSample::Ptr, numSlots> requests;
+    juce::ReferenceCountedArray<Table> tables;
+    std::array<juce::File, numSlots> files;                     // message thread
+
+    // Each carries a reference of its own, which update() takes over.
+    std::array<std::atomic<Table*>, numSlots> pending{};
+    std::array<Table::Ptr, numSlots> playing;                   // audio thread
+
+    std::atomic<int> numOutstanding{ 0 };
+
+    void publish(int slot, Table::Ptr table);
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UserWavetables)
+};
@@ -0,0 +1,293 @@
+/*
+  ==============================================================================
+
+    VoiceBank.cpp
+
+  ==============================================================================
+*/
+
+#include "VoiceBank.h"
+#include "WavetableVoice.h"
+
+void VoiceBank::prepare(int maximumBlockSize, bool doublePrecision)
+{
+    maxBlockSize = maximumBlockSize;
+    const auto envelopeSize = (size_t) (maxChunks * chunkLanes * renderBlockSize);
+
+    if (doublePrecision)
+    {
+        rowsDouble.setSize(maxChunks, maximumBlockSize);
+        envelopesDouble.assign(envelopeSize, 0.0);
+        rows.setSize(0, 0);
+        envelopes = {};
+    }
+    else
+    {
+        rows.setSize(maxChunks, maximumBlockSize);
+        envelopes.assign(envelopeSize, 0.0f);
+        rowsDouble.setSize(0, 0);
+        envelopesDouble = {};
+    }
+}
+
+void VoiceBank::clear() noexcept
+{
+    for (int l = 0; l < numLanes; ++l)
+        voices[(size_t) l]->inVoiceBank = false;
+
+    numLanes = 0;
+}
+
+void VoiceBank::add(WavetableVoice& voice, bool doublePrecision) noexcept
+{
+    jassert(numLanes < maxLanes);
+
+    const auto lane = (size_t) numLanes++;
+    const auto& osc = voice.oscillator;
+
+    voices[lane] = &voice;
+    phases[lane] = osc.getPhase();
+    increments[lane] = osc.getIncrement();
+    levels[lane] = voice.level;
+    tableOffsets[lane] = (int) (tables->get(voice.parameters.wave, osc.getLevel())
+                                - tables->get(voice.parameters.wave, 0));
+
+    // The same for every voice in a block.
+    parameters = &voice.parameters;
+    filterOn = voice.isFilterOn(doublePrecision);
+    filterEngine = voice.filterEngine;
+    jassert(!filterOn || filterEngine != WaveFormSettings::FilterEngines::fir);
+
+    voice.inVoiceBank = true;
+}
+
+void VoiceBank::renderChunk(int chunk, int startSample, int numSamples, bool doublePrecision) noexcept
+{
+    using Engine = WaveFormSettings::FilterEngines;
+
+    if (doublePrecision)
+    {
+        if (!filterOn)
+            renderLanes<double, false, Engine::stateVariable>(chunk, startSample, numSamples);
+        else if (filterEngine == Engine::biquad)
+            renderLanes<double, true, Engine::biquad>(chunk, startSample, numSamples);
+        else
+            renderLanes<double, true, Engine::stateVariable>(chunk, startSample, numSamples);
+    }
+    else
+    {
+        if (!filterOn)
+            renderLanes<float, false, Engine::stateVariable>(chunk, startSample, numSamples);
+        else if (filterEngine == Engine::biquad)
+            renderLanes<float, true, Engine::biquad>(chunk, startSample, numSamples);
+        else
+            renderLanes<float, true, Engine::stateVariable>(chunk, startSample, numSamples);
+    }
+}
+
+template <typename SampleType, bool filtered, WaveFormSettings::FilterEngines sectionType>
+void VoiceBank::renderLanes(int chunk, int startSample, int numSamples) noexcept
+{
+    using Filter = IIRBandFilter<SampleType>;
+    constexpr int numSections = Filter::numSections;
+    constexpr int numCoefficients = Filter::numCoefficients;
+
+    jassert(numSamples <= maxBlockSize);
+
+    const int first = chunk * chunkLanes;
+    const int numInChunk = juce::jmin(chunkLanes, numLanes - first);
+    const int numPadded = (numInChunk + laneWidth - 1) / laneWidth * laneWidth;
+
+    SampleType* mix = getRows<SampleType>().getWritePointer(chunk);
+    SampleType* envelope = getEnvelopes<SampleType>().data() + (size_t) (chunk * chunkLanes * renderBlockSize);
+    const float* table = tables->get(parameters->wave, 0);
+
+    // Padding lanes play nothing: zero increment and filter, and their
+    // envelope column is cleared once here and never written.
+    alignas(32) std::array<SampleType, chunkLanes> start{}, increment{};
+    alignas(32) std::array<int, chunkLanes> offset{};
+    std::array<int, chunkLanes> numRendered{};
+
+    // Filter coefficient k of section s for lane l is at
+    // [(s * numCoefficients + k) * chunkLanes + l]; states likewise.
+    alignas(32) std::array<SampleType, numSections * numCoefficients * chunkLanes> coefficients{};
+    alignas(32) std::array<SampleType, numSections * Filter::numStates * chunkLanes> states{};
+
+    for (int l = 0; l < numInChunk; ++l)
+    {
+        const auto lane = (size_t) (first + l);
+        increment[(size_t) l] = (SampleType) increments[lane];
+        offset[(size_t) l] = tableOffsets[lane];
+
+        if constexpr (filtered)
+        {
+            auto& iir = voices[lane]->template getState<SampleType>().iir;
+
+            for (int section = 0; section < numSections; ++section)
+                for (int k = 0; k < Filter::numStates; ++k)
+                    states[(size_t) ((section * Filter::numStates + k) * chunkLanes + l)] = iir.getState(section)[(size_t) k];
+        }
+    }
+
+    for (int i = 0; i < renderBlockSize; ++i)
+        for (int l = numInChunk; l < numPadded; ++l)
+            envelope[i * numPadded + l] = 0;
+
+    for (int done = 0; done < numSamples; done += renderBlockSize)
+    {
+        const int count = juce::jmin(renderBlockSize, numSamples - done);
+        alignas(32) std::array<SampleType, renderBlockSize> row;
+
+        // Each voice's envelope, scaled by its velocity level, goes into its
+        // column; a release that ends inside the block leaves zeros behind.
+        for (int l = 0; l < numInChunk; ++l)
+        {
+            const auto lane = (size_t) (first + l);
+            auto* voice = voices[lane];
+            const int rendered = voice->env.render(row.data(), count);
+            const SampleType gain = (SampleType) levels[lane];
+
+            for (int i = 0; i < rendered; ++i)
+                envelope[i * numPadded + l] = row[(size_t) i] * gain;
+
+            for (int i = rendered; i < count; ++i)
+                envelope[i * numPadded + l] = 0;
+
+            start[(size_t) l] = (SampleType) phases[lane];
+            numRendered[(size_t) l] = rendered;
+
+            voice->template prepareBankBlock<SampleType>(startSample + done, count, filtered);
+
+            if constexpr (filtered)
+            {
+                const auto& iir = voice->template getState<SampleType>().iir;
+
+                for (int section = 0; section < numSections; ++section)
+                    for (int k = 0; k < numCoefficients; ++k)
+                        coefficients[(size_t) ((section * numCoefficients + k) * chunkLanes + l)]
+                            = iir.getCoefficients(section)[(size_t) k];
+            }
+        }
+
+        SampleType* dest = mix + done;
+
+        for (int i = 0; i < count; ++i)
+        {
+            // One pass across every lane, independent iterations: this is
+            // the loop that runs laneWidth voices per SIMD register.
+            const SampleType t = (SampleType) i;
+            const SampleType* gains = envelope + i * numPadded;
+            alignas(32) std::array<SampleType, chunkLanes> values;
+
+            for (int l = 0; l < numPadded; ++l)
+            {
+                SampleType p = start[(size_t) l] + t * increment[(size_t) l];
+                p -= (SampleType) (int) p;
+
+                const SampleType position = p * (SampleType) WavetableOscillator::tableSize;
+                const int index = (int) position;
+                const SampleType frac = position - (SampleType) index;
+                const SampleType a = table[offset[(size_t) l] + index];
+                const SampleType b = table[offset[(size_t) l] + index + 1];
+
+                SampleType x = a + frac * (b - a);
+
+                if constexpr (filtered)
+                {
+                    for (int section = 0; section < numSections; ++section)
+                    {
+                        SampleType* s = states.data() + section * Filter::numStates * chunkLanes + l;
+                        x = Filter::template tick<sectionType, chunkLanes>(
+                                coefficients.data() + section * numCoefficients * chunkLanes + l,
+                                s[0], s[chunkLanes], x);
+                    }
+                }
+
+                values[(size_t) l] = x * gains[l];
+            }
+
+            std::array<SampleType, laneWidth> sums{};
+
+            for (int group = 0; group < numPadded; group += laneWidth)
+                for (int k = 0; k < laneWidth; ++k)
+                    sums[(size_t) k] += values[(size_t) (group + k)];
+
+            dest[i] = foldLanes(sums);
+        }
+
+        // The same update the oscillator makes after rendering, so a voice
+        // leaving the bank (or starting its next note, which keeps the phase)
+        // carries on from exactly where it would have been.
+        for (int l = 0; l < numInChunk; ++l)
+        {
+            auto& phase = phases[(size_t) (first + l)];
+            phase += numRendered[(size_t) l] * increments[(size_t) (first + l)];
+            phase -= std::floor(phase);
+        }
+    }
+
+    for (int l = 0; l < numInChunk; ++l)
+    {
+        auto* voice = voices[(size_t) (first + l)];
+        voice->oscillator.setPhase(phases[(size_t) (first + l)]);
+
+        const bool finished = !voice->env.isActive();
+
+        // A finished voice's filter kept running on its silent tail here, so
+        // it is reset, as the voice resets it when rendering on its own.
+        if constexpr (filtered)
+        {
+            auto& iir = voice->template getState<SampleType>().iir;
+
+            for (int section = 0; section < numSections; ++section)
+                for (int k = 0; k < Filter::numStates; ++k)
+                    iir.getState(section)[(size_t) k] = states[(size_t) ((section * Filter::numStates + k) * chunkLanes + l)];
+
+            if (finished)
+                iir.reset();
+        }
+
+        if (finished)
+        {
+            // A note that began in "Sample" mode may have been switched to
+            // the bank since; it gives its stream back like any other.
+            voice->sampler.stop();
+            voice->clearCurrentNote();
+        }
+    }
+}
+
+template <typename SampleType>
+void VoiceBank::addTo(juce::AudioBuffer<SampleType>& outputAudio, int startSample, int numSamples, const SampleType* lfo) noexcept
+{
+    if (numLanes == 0)
+        return;
+
+    auto& chunkRows = getRows<SampleType>();
+    SampleType* mix = chunkRows.getWritePointer(0);
+
+    for (int c = 1; c < getNumChunks(); ++c)
+        juce::FloatVectorOperations::add(mix, chunkRows.getReadPointer(c), numSamples);
+
+    // The gain ramp and the tremolo are the same for every voice, so they
+    // are applied to the mix rather than per lane.
+    const SampleType gainStart = (SampleType) parameters->gain.at(startSample);
+    const SampleType gainStep = (SampleType) parameters->gain.step;
+
+    if (lfo != nullptr)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            mix[i] *= (gainStart + gainStep * (SampleType) i) * lfo[startSample + i];
+    }
+    else
+    {
+        for (int i = 0; i < numSamples; ++i)
+            mix[i] *= gainStart + gainStep * (SampleType) i;
+    }
+
+    for (int ch = outputAudio.getNumChannels(); --ch >= 0;)
+        juce::FloatVectorOperations::add(outputAudio.getWritePointer(ch, startSample), mix, numSamples);
+}
+
+template void VoiceBank::addTo<float>(juce::AudioBuffer<float>&, int, int, const float*) noexcept;
+template void VoiceBank::addTo<double>(juce::AudioBuffer<double>&, int, int, const double*) noexcept;
@@ -0,0 +1,137 @@
+/*
+  ==============================================================================
+
+    VoiceBank.h
+
+    Renders many plain voices together instead of one after another. A plain
+    voice is a single oscillator at the host rate with no per-sample
+    modulation, and either no filter of its own or an IIR one. That is every
+    voice in the default patch, where the filter runs once on the bus and the
+    tremolo multiplies the mix, and in cutoff-modulated patches using an IIR
+    filter engine.
+
+    For each block SynthEngine hands the bank those voices, in list order, and
+    the bank copies their state into structure-of-arrays lanes: phases,
+    increments, mip tables and velocity levels each in their own aligned
+    array. The envelopes are rendered by the voices themselves and stored
+    interleaved, sample-major, so sample i of every lane sits in one run. The
+    inner loop then advances a fixed group of laneWidth voices in lockstep,
+    with no dependency between the lanes, so each group is one set of SIMD
+    operations (8 floats fill an AVX register); per-lane sums are folded into
+    the mix once per sample.
+
+    Per-voice IIR filters run in the same loop. Their section coefficients
+    and states are copied into lane arrays too, one array per coefficient,
+    and IIRBandFilter::tick steps every lane through its own filter at once.
+    The coefficients are refreshed from the voices each sub-block, after any
+    cutoff modulation, and the states are handed back at the end.
+
+    The lanes are split into chunks of chunkLanes voices, each mixed into its
+    own row. Chunks are the jobs handed to VoiceRenderPool's workers, and the
+    rows are always added up in chunk order, so the mix is the same whether
+    the chunks ran on one thread or several.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "WavetableOscillator.h"
+#include "ParameterSnapshot.h"
+#include "IIRBandFilter.h"
+#include <array>
+#include <type_traits>
+#include <vector>
+
+class WavetableVoice;
+
+class VoiceBank
+{
+public:
+    static constexpr int laneWidth = 8;
+    static constexpr int chunkLanes = 32;
+    static constexpr int maxLanes = 256;
+    static constexpr int maxChunks = maxLanes / chunkLanes;
+
+    VoiceBank() = default;
+
+    // Allocates the chunk rows in the precision the host will render in. Not realtime safe.
+    void prepare(int maximumBlockSize, bool doublePrecision);
+    int getMaximumBlockSize() const noexcept { return maxBlockSize; }
+
+    // Collects the voices for the next render. Add them in list order; the
+    // mix is summed in that order.
+    void clear() noexcept;
+    void add(WavetableVoice& voice, bool doublePrecision) noexcept;
+
+    int getNumLanes() const noexcept { return numLanes; }
+    int getNumChunks() const noexcept { return (numLanes + chunkLanes - 1) / chunkLanes; }
+
+    // Renders one chunk's voices into its row and moves their oscillators and
+    // envelopes on. Voices whose release finishes are cleared. Different
+    // chunks may be rendered on different threads at the same time.
+    void renderChunk(int chunk, int startSample, int numSamples, bool doublePrecision) noexcept;
+
+    // Sums the chunk rows, applies the output gain and the tremolo (when lfo
+    // isn't nullptr) and adds the result to every channel of outputAudio.
+    template <typename SampleType>
+    void addTo(juce::AudioBuffer<SampleType>& outputAudio, int startSample, int numSamples, const SampleType* lfo) noexcept;
+
+private:
+    // Sub-block the envelopes are interleaved in; the same as the voice's.
+    static constexpr int renderBlockSize = 128;
+
+    juce::SharedResourcePointer<WavetableOscillator::Tables> tables;
+
+    std::array<WavetableVoice*, maxLanes> voices{};
+    int numLanes = 0;
+    const ParameterSnapshot* parameters = nullptr;
+    bool filterOn = false;
+    WaveFormSettings::FilterEngines filterEngine = WaveFormSettings::FilterEngines::stateVariable;
+
+    // Per-block lane state, copied from the voices by add().
+    alignas(64) std::array<double, maxLanes> phases{};
+    alignas(64) std::array<double, maxLanes> increments{};
+    alignas(64) std::array<double, maxLanes> levels{};
+    alignas(64) std::array<int, maxLanes> tableOffsets{}; // from the waveform's level 0
+
+    int maxBlockSize = 0;
+    juce::AudioBuffer<float> rows;                // one per chunk, float hosts
+    juce::AudioBuffer<double> rowsDouble;         // the same, double precision hosts
+    std::vector<float> envelopes;                 // renderBlockSize * chunkLanes per chunk
+    std::vector<double> envelopesDouble;
+
+    template <typename SampleType>
+    juce::AudioBuffer<SampleType>& getRows() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return rowsDouble;
+        else
+            return rows;
+    }
+
+    template <typename SampleType>
+    std::vector<SampleType>& getEnvelopes() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return envelopesDouble;
+        else
+            return envelopes;
+    }
+
+    template <typename SampleType, bool filtered, WaveFormSettings::FilterEngines sectionType>
+    void renderLanes(int chunk, int startSample, int numSamples) noexcept;
+
+    // Pairwise sum of one sample's lane group; each step is a vector add.
+    template <typename SampleType>
+    static SampleType foldLanes(std::array<SampleType, laneWidth>& sums) noexcept
+    {
+        for (int width = laneWidth / 2; width > 0; width /= 2)
+            for (int k = 0; k < width; ++k)
+                sums[(size_t) k] += sums[(size_t) (k + width)];
+
+        return sums[0];
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(VoiceBank)
+};
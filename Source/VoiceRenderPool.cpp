@@ -0,0 +1,346 @@
+/*
+  ==============================================================================
+
+    VoiceRenderPool.cpp
+
+  ==============================================================================
+*/
+
+#include "VoiceRenderPool.h"
+#include "SimdOps.h"
+#include <thread>
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#else
+ #include <semaphore.h>
+ #include <cerrno>
+ #include <ctime>
+#endif
+
+namespace
+{
+    constexpr uint64_t packRange(uint32_t begin, uint32_t end) noexcept
+    {
+        return ((uint64_t) begin << 32) | end;
+    }
+
+    // How a worker waits for the next batch: it spins for spinMs after its
+    // last job, then yields until the pool has been idle for several batch
+    // intervals, and only then parks.
+    constexpr double spinMs = 0.05;
+    constexpr double minYieldMs = 1.0;
+    constexpr double maxYieldMs = 50.0;
+    constexpr double intervalsBeforeParking = 4.0;
+    constexpr int parkTimeoutMs = 100;
+
+    // The join spins this many times before it starts yielding its core.
+    constexpr int joinSpinIterations = 4000;
+
+    // Tells the core this is a spin-wait, so a hyperthread sharing it gets
+    // the execution resources and the loop doesn't hammer the cache line.
+    inline void cpuPause() noexcept
+    {
+       #if SIMDOPS_AVX2 || SIMDOPS_SSE2
+        _mm_pause();
+       #elif SIMDOPS_NEON && (defined(__GNUC__) || defined(__clang__))
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+
+    // A counting semaphore from the OS. post() never blocks and takes no
+    // lock on any of these; it only enters the kernel when a thread is
+    // actually asleep on it.
+    class Semaphore
+    {
+    public:
+       #if JUCE_WINDOWS
+        Semaphore() : handle(CreateSemaphoreW(nullptr, 0, 0x7fffffff, nullptr)) {}
+        ~Semaphore() { CloseHandle(handle); }
+        void post() noexcept { ReleaseSemaphore(handle, 1, nullptr); }
+        bool wait(int ms) noexcept { return WaitForSingleObject(handle, ms < 0 ? INFINITE : (DWORD) ms) == WAIT_OBJECT_0; }
+       #elif JUCE_MAC || JUCE_IOS
+        Semaphore() : handle(dispatch_semaphore_create(0)) {}
+        ~Semaphore() { dispatch_release(handle); }
+        void post() noexcept { dispatch_semaphore_signal(handle); }
+
+        bool wait(int ms) noexcept
+        {
+            const auto timeout = ms < 0 ? DISPATCH_TIME_FOREVER : dispatch_time(DISPATCH_TIME_NOW, (int64_t) ms * NSEC_PER_MSEC);
+            return dispatch_semaphore_wait(handle, timeout) == 0;
+        }
+       #else
+        Semaphore() { sem_init(&handle, 0, 0); }
+        ~Semaphore() { sem_destroy(&handle); }
+        void post() noexcept { sem_post(&handle); }
+
+        bool wait(int ms) noexcept
+        {
+            if (ms < 0)
+            {
+                while (sem_wait(&handle) != 0) {}
+                return true;
+            }
+
+            timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += ms / 1000;
+            deadline.tv_nsec += (long) (ms % 1000) * 1000000;
+
+            if (deadline.tv_nsec >= 1000000000)
+            {
+                ++deadline.tv_sec;
+                deadline.tv_nsec -= 1000000000;
+            }
+
+            while (sem_timedwait(&handle, &deadline) != 0)
+                if (errno != EINTR)
+                    return false;
+
+            return true;
+        }
+       #endif
+
+    private:
+       #if JUCE_WINDOWS
+        HANDLE handle;
+       #elif JUCE_MAC || JUCE_IOS
+        dispatch_semaphore_t handle;
+       #else
+        sem_t handle;
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE(Semaphore)
+    };
+}
+
+//==============================================================================
+class VoiceRenderPool::Worker : public juce::Thread
+{
+public:
+    Worker(VoiceRenderPool& p, int index)
+        : juce::Thread("Voice render " + juce::String(index)),
+        pool(p),
+        participant(index)
+    {
+    }
+
+    // Whoever clears the flag owns the single post a parked worker waits
+    // for, so the audio thread posts at most once per park and never waits.
+    void wake() noexcept
+    {
+        if (parked.load(std::memory_order_relaxed) && parked.exchange(false))
+            semaphore.post();
+    }
+
+    void run() override
+    {
+        uint32_t seen = pool.generation.load();
+
+        while (!pool.shouldExit.load(std::memory_order_relaxed))
+        {
+            if (!waitForBatch(seen))
+                continue;
+
+            seen = pool.generation.load();
+            pool.work(participant);
+        }
+    }
+
+private:
+    VoiceRenderPool& pool;
+    const int participant;
+    Semaphore semaphore;
+    std::atomic<bool> parked{ false };
+
+    bool batchPending(uint32_t seen) const noexcept
+    {
+        return pool.generation.load() != seen
+            || pool.shouldExit.load(std::memory_order_relaxed);
+    }
+
+    bool waitForBatch(uint32_t seen)
+    {
+        // With batches arriving every block the worker stays awake across
+        // the gaps; only once the pool has been idle for several of them
+        // (playback stopped) is it worth a kernel round trip to wake it.
+        const double interval = pool.batchIntervalMs.load(std::memory_order_relaxed);
+        const double yieldMs = juce::jlimit(minYieldMs, maxYieldMs, intervalsBeforeParking * interval);
+        const double waitingSince = juce::Time::getMillisecondCounterHiRes();
+
+        for (;;)
+        {
+            if (batchPending(seen))
+                return true;
+
+            const double now = juce::Time::getMillisecondCounterHiRes();
+
+            if (now - pool.lastBatchMs.load(std::memory_order_relaxed) >= yieldMs)
+                break;
+
+            if (now - waitingSince < spinMs)
+                cpuPause();
+            else
+                std::this_thread::yield();
+        }
+
+        // Publish that we're parked before the final check, so run() either
+        // sees the flag and posts, or we see its new generation here.
+        parked.store(true);
+        bool posted = false;
+
+        if (!batchPending(seen))
+            posted = semaphore.wait(parkTimeoutMs);
+
+        // Without a post: if the flag is still set nobody will send one.
+        // Otherwise wake() has cleared it and posted, or is about to; take
+        // that post so the count is back at zero for the next park.
+        if (!posted && !parked.exchange(false))
+            semaphore.wait(-1);
+
+        return batchPending(seen);
+    }
+};
+
+//==============================================================================
+VoiceRenderPool::VoiceRenderPool(int numWorkers, std::function<void(int)> jobToRun)
+    : job(std::move(jobToRun)),
+    slices((size_t) numWorkers + 1)
+{
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(*this, i + 1));
+        auto& worker = *workers.back();
+
+        if (!worker.startRealtimeThread(juce::Thread::RealtimeOptions{}) && !worker.isThreadRunning())
+            worker.startThread(juce::Thread::Priority::highest);
+    }
+}
+
+VoiceRenderPool::~VoiceRenderPool()
+{
+    shouldExit.store(true);
+
+    for (auto& w : workers)
+    {
+        w->signalThreadShouldExit();
+        w->wake();
+    }
+
+    for (auto& w : workers)
+        w->stopThread(1000);
+}
+
+void VoiceRenderPool::run(int numJobs) noexcept
+{
+    if (numJobs <= 0)
+        return;
+
+    // Every index of the previous batch has been run by now, so all slices are
+    // empty. A worker still leaving the last batch may pick up work as soon as
+    // a slice is refilled, so the count and the caller's job data must be
+    // published before (the release stores) the ranges.
+    const int numParticipants = (int) slices.size();
+    remaining.store(numJobs, std::memory_order_relaxed);
+
+    for (int p = 0; p < numParticipants; ++p)
+    {
+        const auto begin = (uint32_t) (numJobs * p / numParticipants);
+        const auto end = (uint32_t) (numJobs * (p + 1) / numParticipants);
+        slices[(size_t) p].range.store(packRange(begin, end), std::memory_order_release);
+    }
+
+    const double now = juce::Time::getMillisecondCounterHiRes();
+    const double previous = lastBatchMs.exchange(now, std::memory_order_relaxed);
+    batchIntervalMs.store(now - previous, std::memory_order_relaxed);
+
+    generation.fetch_add(1);
+
+    for (auto& w : workers)
+        w->wake();
+
+    work(0);
+
+    // Another participant is still finishing its last job. It is short, so
+    // spin politely first, then give the core away in case that participant
+    // is waiting for it.
+    for (int i = 0; remaining.load(std::memory_order_acquire) > 0; ++i)
+    {
+        if (i < joinSpinIterations)
+            cpuPause();
+        else
+            std::this_thread::yield();
+    }
+}
+
+void VoiceRenderPool::work(int participant) noexcept
+{
+    const int numParticipants = (int) slices.size();
+    int index;
+
+    while (takeFront(participant, index))
+    {
+        job(index);
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    for (int offset = 1; offset < numParticipants; ++offset)
+    {
+        const int victim = (participant + offset) % numParticipants;
+
+        while (stealBack(victim, index))
+        {
+            job(index);
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+bool VoiceRenderPool::takeFront(int slice, int& index) noexcept
+{
+    auto& range = slices[(size_t) slice].range;
+    auto current = range.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        const auto begin = (uint32_t) (current >> 32);
+        const auto end = (uint32_t) current;
+
+        if (begin >= end)
+            return false;
+
+        if (range.compare_exchange_weak(current, packRange(begin + 1, end),
+                                        std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            index = (int) begin;
+            return true;
+        }
+    }
+}
+
+bool VoiceRenderPool::stealBack(int slice, int& index) noexcept
+{
+    auto& range = slices[(size_t) slice].range;
+    auto current = range.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        const auto begin = (uint32_t) (current >> 32);
+        const auto end = (uint32_t) current;
+
+        if (begin >= end)
+            return false;
+
+        if (range.compare_exchange_weak(current, packRange(begin, end - 1),
+                                        std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            index = (int) end - 1;
+            return true;
+        }
+    }
+}
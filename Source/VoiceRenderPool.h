@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+
+    VoiceRenderPool.h
+
+    Pre-spawned worker threads that run a fixed job over a batch of indices
+    together with the calling (audio) thread.
+
+    At the start of a batch the index range is split into one contiguous
+    slice per participant. Each slice is a single 64-bit atomic holding
+    [begin, end): its owner takes work from the front, and participants
+    that run dry steal from the back of the other slices. Both ends move by
+    compare-and-swap on the same word, so the slices are lock-free deques
+    that never grow, which is all a batch whose size is known up front needs.
+
+    Nothing on the audio path allocates, locks or blocks. How an idle worker
+    waits depends on how long the pool has gone without a batch: it spins
+    briefly, then yields, and only parks on a semaphore once the pool has
+    been idle for several batch intervals, i.e. when playback has stopped.
+    The audio thread only ever posts to that semaphore, which never blocks,
+    and only when a worker is actually parked.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class VoiceRenderPool
+{
+public:
+    // job(index) is called once for every index of every batch.
+    VoiceRenderPool(int numWorkers, std::function<void(int)> job);
+    ~VoiceRenderPool();
+
+    int getNumWorkers() const noexcept { return (int) workers.size(); }
+
+    // Runs job(0) .. job(numJobs - 1) on the workers and the calling thread,
+    // and returns once all of them have finished.
+    void run(int numJobs) noexcept;
+
+private:
+    class Worker;
+
+    struct alignas(64) Slice
+    {
+        std::atomic<uint64_t> range{ 0 }; // begin << 32 | end
+    };
+
+    const std::function<void(int)> job;
+    std::vector<Slice> slices;                // slice 0 belongs to the calling thread
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::atomic<uint32_t> generation{ 0 };
+    std::atomic<int> remaining{ 0 };
+    std::atomic<bool> shouldExit{ false };
+
+    // Set by run(); the workers size their idle back-off from these.
+    std::atomic<double> lastBatchMs{ 0.0 };
+    std::atomic<double> batchIntervalMs{ 0.0 };
+
+    void work(int participant) noexcept;
+    bool takeFront(int slice, int& index) noexcept;
+    bool stealBack(int slice, int& index) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceRenderPool)
+};
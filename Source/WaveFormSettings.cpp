@@ -1,4 +1,23 @@
 #include "WaveFormSettings.h"
+#include "ParameterSnapshot.h"
+
+namespace
+{
+    // Advances a smoother over the block and returns it as a linear ramp
+    // whose value at sample i is what getNextValue() would return there.
+    ParameterSnapshot::Ramp nextRamp (juce::SmoothedValue<float>& smoother, float target, int numSamples) noexcept
+    {
+        smoother.setTargetValue (target);
+
+        if (numSamples <= 0)
+            return { smoother.getCurrentValue(), 0.0f };
+
+        const float current = smoother.getCurrentValue();
+        const float step = (smoother.skip (numSamples) - current) / (float) numSamples;
+
+        return { current + step, step };
+    }
+}
 
 WaveFormSettings::WaveFormSettings (juce::AudioProcessorValueTreeState& apvts)
 {
@@ -6,6 +25,10 @@ WaveFormSettings::WaveFormSettings (juce::AudioProcessorValueTreeState& apvts)
     gainDbParam     = apvts.getRawParameterValue ("gain");
     cutoffLowParam  = apvts.getRawParameterValue ("cutoffLow");
     cutoffHighParam = apvts.getRawParameterValue ("cutoffHigh");
+    filterLengthParam = apvts.getRawParameterValue ("filterLength");
+    polyphonyParam = apvts.getRawParameterValue ("polyphony");
+    voiceStealingParam = apvts.getRawParameterValue ("voiceStealing");
+    multiCoreParam = apvts.getRawParameterValue ("multiCoreRendering");
 	attackParam = apvts.getRawParameterValue("attack");
     decayParam = apvts.getRawParameterValue ("decay");
     sustainParam = apvts.getRawParameterValue ("sustain");
@@ -16,9 +39,179 @@ WaveFormSettings::WaveFormSettings (juce::AudioProcessorValueTreeState& apvts)
 	lfoFreqParam = apvts.getRawParameterValue("tremoloFreq");
 	lfoDepthParam = apvts.getRawParameterValue("tremoloDepth");
 
+    for (int r = 0; r < numModRoutes; ++r)
+    {
+        const juce::String prefix = "mod" + juce::String (r + 1);
+        modSourceParams[(size_t) r] = apvts.getRawParameterValue (prefix + "Source");
+        modDestinationParams[(size_t) r] = apvts.getRawParameterValue (prefix + "Destination");
+        modAmountParams[(size_t) r] = apvts.getRawParameterValue (prefix + "Amount");
+    }
+
+    for (int l = 0; l < numModLfos; ++l)
+    {
+        const juce::String prefix = "lfo" + juce::String (l + 1);
+        modLfoWaveParams[(size_t) l] = apvts.getRawParameterValue (prefix + "Wave");
+        modLfoRateParams[(size_t) l] = apvts.getRawParameterValue (prefix + "Rate");
+    }
+
+    modAttackParam = apvts.getRawParameterValue ("modAttack");
+    modDecayParam = apvts.getRawParameterValue ("modDecay");
+    modSustainParam = apvts.getRawParameterValue ("modSustain");
+    modReleaseParam = apvts.getRawParameterValue ("modRelease");
+
+    oversamplingParam = apvts.getRawParameterValue ("oversampling");
+    oversamplingOfflineParam = apvts.getRawParameterValue ("oversamplingOffline");
+
+    unisonVoicesParam = apvts.getRawParameterValue ("unisonVoices");
+    unisonDetuneParam = apvts.getRawParameterValue ("unisonDetune");
+    unisonSpreadParam = apvts.getRawParameterValue ("unisonSpread");
+
+    filterEngineParam = apvts.getRawParameterValue ("filterEngine");
+
+    chorusRateParam = apvts.getRawParameterValue ("chorusRate");
+    chorusDepthParam = apvts.getRawParameterValue ("chorusDepth");
+    chorusMixParam = apvts.getRawParameterValue ("chorusMix");
+    flangerRateParam = apvts.getRawParameterValue ("flangerRate");
+    flangerDepthParam = apvts.getRawParameterValue ("flangerDepth");
+    flangerFeedbackParam = apvts.getRawParameterValue ("flangerFeedback");
+    flangerMixParam = apvts.getRawParameterValue ("flangerMix");
+    delayTimeParam = apvts.getRawParameterValue ("delayTime");
+    delayFeedbackParam = apvts.getRawParameterValue ("delayFeedback");
+    delayMixParam = apvts.getRawParameterValue ("delayMix");
+
+    oscillatorModeParam = apvts.getRawParameterValue ("oscillatorMode");
+    sampleRootNoteParam = apvts.getRawParameterValue ("sampleRootNote");
+    sampleLoopParam = apvts.getRawParameterValue ("sampleLoop");
+    sampleStreamingParam = apvts.getRawParameterValue ("sampleStreaming");
+    samplePreloadParam = apvts.getRawParameterValue ("samplePreload");
+    wavetablePositionParam = apvts.getRawParameterValue ("wavetablePosition");
+
     jassert (waveParam && gainDbParam && cutoffLowParam && cutoffHighParam);
 }
 
+void WaveFormSettings::prepare (double sampleRate)
+{
+    gainSmoother.reset (sampleRate, 0.02);
+    tremoloFreqSmoother.reset (sampleRate, 0.05);
+    tremoloDepthSmoother.reset (sampleRate, 0.05);
+    delayTimeSmoother.reset (sampleRate, 0.1);
+    wavetablePositionSmoother.reset (sampleRate, 0.05);
+
+    gainSmoother.setCurrentAndTargetValue (getVelocity());
+    tremoloFreqSmoother.setCurrentAndTargetValue (getLfoFreqValue());
+    tremoloDepthSmoother.setCurrentAndTargetValue (getLfoDepthValue());
+    delayTimeSmoother.setCurrentAndTargetValue (getDelayTimeValue());
+    wavetablePositionSmoother.setCurrentAndTargetValue (getWavetablePosition());
+
+    hasCaptured = false;
+}
+
+void WaveFormSettings::capture (ParameterSnapshot& s, int numSamples) noexcept
+{
+    const ParameterSnapshot previous = s;
+
+    s.numSamples = numSamples;
+
+    s.wave = getSelectedWaveForm();
+    s.userWavetable = getUserWavetable();
+    s.wavetablePosition = nextRamp (wavetablePositionSmoother, getWavetablePosition(), numSamples);
+    s.gain = nextRamp (gainSmoother, getVelocity(), numSamples);
+
+    s.unisonVoices = getUnisonVoices();
+    s.unisonDetune = getUnisonDetune();
+    s.unisonSpread = getUnisonSpread();
+
+    s.cutoffLow = getCutoffLowFrequency();
+    s.cutoffHigh = getCutoffHighFrequency();
+    s.filterTaps = getFilterTaps();
+
+    s.attack = getAttackValue();
+    s.decay = getDecayValue();
+    s.sustain = getSustainValue();
+    s.release = getReleaseValue();
+
+    s.tremoloOn = getLfoOnValue();
+    s.tremoloWave = getLfoWaveValue();
+    s.tremoloFreq = nextRamp (tremoloFreqSmoother, getLfoFreqValue(), numSamples);
+    s.tremoloDepth = nextRamp (tremoloDepthSmoother, getLfoDepthValue(), numSamples);
+
+    s.polyphony = getPolyphony();
+    s.voiceStealing = getVoiceStealingIndex();
+
+    for (int r = 0; r < numModRoutes; ++r)
+        s.modRoutes[(size_t) r] = { getModSource (r), getModDestination (r), getModAmount (r) };
+
+    for (int l = 0; l < numModLfos; ++l)
+        s.modLfos[(size_t) l] = { getModLfoWave (l), getModLfoRate (l) };
+
+    s.modAttack = getModAttackValue();
+    s.modDecay = getModDecayValue();
+    s.modSustain = getModSustainValue();
+    s.modRelease = getModReleaseValue();
+
+    auto read = [] (const std::atomic<float>* param, float fallback)
+    {
+        return (param != nullptr) ? param->load() : fallback;
+    };
+
+    s.fx.chorusRate = read (chorusRateParam, 0.8f);
+    s.fx.chorusDepth = read (chorusDepthParam, 0.5f);
+    s.fx.chorusMix = read (chorusMixParam, 0.5f);
+    s.fx.flangerRate = read (flangerRateParam, 0.25f);
+    s.fx.flangerDepth = read (flangerDepthParam, 0.7f);
+    s.fx.flangerFeedback = read (flangerFeedbackParam, 0.5f);
+    s.fx.flangerMix = read (flangerMixParam, 0.5f);
+    s.fx.delayFeedback = read (delayFeedbackParam, 0.35f);
+    s.fx.delayMix = read (delayMixParam, 0.3f);
+
+    // A jump in delay time would click, so the delay glides to it instead.
+    s.fx.delayTime = nextRamp (delayTimeSmoother, getDelayTimeValue(), numSamples);
+
+    s.oscillatorMode = getOscillatorMode();
+    s.sampleRootNote = (int) read (sampleRootNoteParam, 60.0f);
+    s.sampleLoop = read (sampleLoopParam, 0.0f) > 0.5f;
+    s.sampleStreaming = getSampleStreaming();
+
+    if (! hasCaptured)
+    {
+        s.changed = ParameterSnapshot::allChanged;
+        hasCaptured = true;
+        return;
+    }
+
+    s.changed = 0;
+
+    if (s.wave != previous.wave || s.userWavetable != previous.userWavetable
+        || s.oscillatorMode != previous.oscillatorMode)
+        s.changed |= ParameterSnapshot::waveChanged;
+
+    if (s.unisonVoices != previous.unisonVoices || s.unisonDetune != previous.unisonDetune
+        || s.unisonSpread != previous.unisonSpread)
+        s.changed |= ParameterSnapshot::unisonChanged;
+
+    if (s.cutoffLow != previous.cutoffLow || s.cutoffHigh != previous.cutoffHigh)
+        s.changed |= ParameterSnapshot::cutoffChanged;
+
+    if (s.filterTaps != previous.filterTaps)
+        s.changed |= ParameterSnapshot::filterLengthChanged;
+
+    if (s.attack != previous.attack || s.decay != previous.decay
+        || s.sustain != previous.sustain || s.release != previous.release)
+        s.changed |= ParameterSnapshot::envelopeChanged;
+
+    if (s.tremoloOn != previous.tremoloOn || s.tremoloWave != previous.tremoloWave
+        || s.tremoloFreq.isSmoothing() || s.tremoloDepth.isSmoothing())
+        s.changed |= ParameterSnapshot::tremoloChanged;
+
+    if (s.polyphony != previous.polyphony || s.voiceStealing != previous.voiceStealing)
+        s.changed |= ParameterSnapshot::voicesChanged;
+
+    if (s.modRoutes != previous.modRoutes || s.modLfos != previous.modLfos
+        || s.modAttack != previous.modAttack || s.modDecay != previous.modDecay
+        || s.modSustain != previous.modSustain || s.modRelease != previous.modRelease)
+        s.changed |= ParameterSnapshot::modulationChanged;
+}
+
 WaveFormSettings::WaveForms WaveFormSettings::getSelectedWaveForm() const noexcept
 {
     const int idx = (waveParam != nullptr) ? (int) waveParam->load() : 0;
@@ -33,6 +226,33 @@ WaveFormSettings::WaveForms WaveFormSettings::getSelectedWaveForm() const noexce
     }
 }
 
+int WaveFormSettings::getUserWavetable() const noexcept
+{
+    // The user slots follow the four built-in shapes in the choice.
+    const int idx = (waveParam != nullptr) ? (int) waveParam->load() : 0;
+    return idx >= 4 ? idx - 4 : -1;
+}
+
+float WaveFormSettings::getWavetablePosition() const noexcept
+{
+    return (wavetablePositionParam != nullptr) ? wavetablePositionParam->load() : 0.0f;
+}
+
+int WaveFormSettings::getUnisonVoices() const noexcept
+{
+    return (unisonVoicesParam != nullptr) ? (int) unisonVoicesParam->load() : 1;
+}
+
+float WaveFormSettings::getUnisonDetune() const noexcept
+{
+    return (unisonDetuneParam != nullptr) ? unisonDetuneParam->load() : 15.0f;
+}
+
+float WaveFormSettings::getUnisonSpread() const noexcept
+{
+    return (unisonSpreadParam != nullptr) ? unisonSpreadParam->load() : 0.5f;
+}
+
 float WaveFormSettings::getVelocity() const noexcept
 {
     const float gainDb = (gainDbParam != nullptr) ? gainDbParam->load() : 0.0f;
@@ -49,6 +269,53 @@ float WaveFormSettings::getCutoffHighFrequency() const noexcept
     return (cutoffHighParam != nullptr) ? cutoffHighParam->load() : 20000.0f;
 }
 
+int WaveFormSettings::getFilterTaps() const noexcept
+{
+    const int idx = (filterLengthParam != nullptr) ? (int) filterLengthParam->load() : 0;
+
+    switch (idx)
+    {
+        case 1: return 1023;
+        case 2: return 4095;
+        default: return 101;
+    }
+}
+
+WaveFormSettings::FilterEngines WaveFormSettings::getFilterEngine() const noexcept
+{
+    const int idx = (filterEngineParam != nullptr) ? (int) filterEngineParam->load() : 0;
+
+    switch (idx)
+    {
+        case 1: return FilterEngines::stateVariable;
+        case 2: return FilterEngines::biquad;
+        default: return FilterEngines::fir;
+    }
+}
+
+int WaveFormSettings::getPolyphony() const noexcept
+{
+    return (polyphonyParam != nullptr) ? (int) polyphonyParam->load() : 10;
+}
+
+int WaveFormSettings::getVoiceStealingIndex() const noexcept
+{
+    return (voiceStealingParam != nullptr) ? (int) voiceStealingParam->load() : 0;
+}
+
+int WaveFormSettings::getOversamplingFactor(bool nonRealtime) const noexcept
+{
+    auto* param = nonRealtime ? oversamplingOfflineParam : oversamplingParam;
+    const int idx = (param != nullptr) ? juce::jlimit(0, 3, (int) param->load()) : 0;
+
+    return 1 << idx;
+}
+
+bool WaveFormSettings::getMultiCoreRendering() const noexcept
+{
+    return (multiCoreParam != nullptr) && multiCoreParam->load() >= 0.5f;
+}
+
 float WaveFormSettings::getAttackValue() const noexcept
 {
     return (attackParam != nullptr) ? attackParam->load() : 100;
@@ -98,3 +365,98 @@ float WaveFormSettings::getLfoDepthValue() const noexcept
 	return (lfoDepthParam != nullptr) ? lfoDepthParam->load() : 0.f;
 }
 
+
+WaveFormSettings::ModSources WaveFormSettings::getModSource (int route) const noexcept
+{
+    auto* param = modSourceParams[(size_t) route];
+    const int idx = (param != nullptr) ? (int) param->load() : 0;
+
+    switch (idx)
+    {
+        case 1: return ModSources::lfo1;
+        case 2: return ModSources::lfo2;
+        case 3: return ModSources::modEnvelope;
+        default: return ModSources::none;
+    }
+}
+
+WaveFormSettings::ModDestinations WaveFormSettings::getModDestination (int route) const noexcept
+{
+    auto* param = modDestinationParams[(size_t) route];
+    const int idx = (param != nullptr) ? (int) param->load() : 0;
+
+    switch (idx)
+    {
+        case 1: return ModDestinations::cutoff;
+        case 2: return ModDestinations::amplitude;
+        case 3: return ModDestinations::pan;
+        default: return ModDestinations::pitch;
+    }
+}
+
+float WaveFormSettings::getModAmount (int route) const noexcept
+{
+    auto* param = modAmountParams[(size_t) route];
+    return (param != nullptr) ? param->load() : 0.0f;
+}
+
+WaveFormSettings::WaveForms WaveFormSettings::getModLfoWave (int lfo) const noexcept
+{
+    auto* param = modLfoWaveParams[(size_t) lfo];
+    const int idx = (param != nullptr) ? (int) param->load() : 0;
+
+    switch (idx)
+    {
+        case 1: return WaveForms::square;
+        case 2: return WaveForms::triangle;
+        case 3: return WaveForms::sawtooth;
+        default: return WaveForms::sine;
+    }
+}
+
+float WaveFormSettings::getModLfoRate (int lfo) const noexcept
+{
+    auto* param = modLfoRateParams[(size_t) lfo];
+    return (param != nullptr) ? param->load() : 1.0f;
+}
+
+float WaveFormSettings::getModAttackValue() const noexcept
+{
+    return (modAttackParam != nullptr) ? modAttackParam->load() : 10;
+}
+
+float WaveFormSettings::getModDecayValue() const noexcept
+{
+    return (modDecayParam != nullptr) ? modDecayParam->load() : 300;
+}
+
+float WaveFormSettings::getModSustainValue() const noexcept
+{
+    return (modSustainParam != nullptr) ? modSustainParam->load() : 0.5;
+}
+
+float WaveFormSettings::getModReleaseValue() const noexcept
+{
+    return (modReleaseParam != nullptr) ? modReleaseParam->load() : 300;
+}
+
+float WaveFormSettings::getDelayTimeValue() const noexcept
+{
+    return (delayTimeParam != nullptr) ? delayTimeParam->load() : 375.0f;
+}
+
+WaveFormSettings::OscillatorModes WaveFormSettings::getOscillatorMode() const noexcept
+{
+    const int idx = (oscillatorModeParam != nullptr) ? (int) oscillatorModeParam->load() : 0;
+    return idx == 1 ? OscillatorModes::sample : OscillatorModes::wavetable;
+}
+
+bool WaveFormSettings::getSampleStreaming() const noexcept
+{
+    return (sampleStreamingParam != nullptr) ? sampleStreamingParam->load() > 0.5f : false;
+}
+
+float WaveFormSettings::getSamplePreloadMs() const noexcept
+{
+    return (samplePreloadParam != nullptr) ? samplePreloadParam->load() : 250.0f;
+}
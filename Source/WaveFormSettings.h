@@ -1,5 +1,8 @@
 #pragma once
 #include <JuceHeader.h>
+#include <array>
+
+struct ParameterSnapshot;
 
 class WaveFormSettings
 {
@@ -12,15 +15,75 @@ public:
         sawtooth
     };
 
+    // Modulation matrix: each route sends one source to one destination.
+    enum class ModSources
+    {
+        none = 0,
+        lfo1,
+        lfo2,
+        modEnvelope
+    };
+
+    enum class ModDestinations
+    {
+        pitch = 0,
+        cutoff,
+        amplitude,
+        pan
+    };
+
+    // What the band filter is built from; see FIRFilter and IIRBandFilter.
+    enum class FilterEngines
+    {
+        fir = 0,
+        stateVariable,
+        biquad
+    };
+
+    // What the voice's oscillator plays: the wave tables, or the processor's
+    // memory-mapped sample (see SampleOscillator).
+    enum class OscillatorModes
+    {
+        wavetable = 0,
+        sample
+    };
+
+    static constexpr int numModRoutes = 4;
+    static constexpr int numModLfos = 2;
+
     // Processor-owned: pass APVTS so we can read parameters safely
     explicit WaveFormSettings (juce::AudioProcessorValueTreeState& apvts);
 
+    // Resets the smoothers; call from prepareToPlay.
+    void prepare (double sampleRate);
+
+    // Reads every parameter once and fills the snapshot for the next numSamples.
+    // Audio thread only.
+    void capture (ParameterSnapshot& snapshot, int numSamples) noexcept;
+
     WaveForms getSelectedWaveForm() const noexcept;
 
+    // The "User" slot chosen for "wave", or -1 for one of the WaveForms.
+    int getUserWavetable() const noexcept;
+    float getWavetablePosition() const noexcept;
+
+    int getUnisonVoices() const noexcept;
+    float getUnisonDetune() const noexcept;
+    float getUnisonSpread() const noexcept;
+
     float getVelocity() const noexcept;
 
     float getCutoffLowFrequency() const noexcept;
     float getCutoffHighFrequency() const noexcept;
+    int getFilterTaps() const noexcept;
+    FilterEngines getFilterEngine() const noexcept;
+
+    // 1, 2, 4 or 8; realtime and offline rendering have separate settings.
+    int getOversamplingFactor(bool nonRealtime) const noexcept;
+
+    int getPolyphony() const noexcept;
+    int getVoiceStealingIndex() const noexcept;
+    bool getMultiCoreRendering() const noexcept;
 
     float getAttackValue() const noexcept;
     float getDecayValue() const noexcept;
@@ -32,11 +95,43 @@ public:
 	float getLfoFreqValue() const noexcept;
 	float getLfoDepthValue() const noexcept;
 
+    ModSources getModSource (int route) const noexcept;
+    ModDestinations getModDestination (int route) const noexcept;
+    float getModAmount (int route) const noexcept;
+
+    WaveForms getModLfoWave (int lfo) const noexcept;
+    float getModLfoRate (int lfo) const noexcept;
+
+    float getModAttackValue() const noexcept;
+    float getModDecayValue() const noexcept;
+    float getModSustainValue() const noexcept;
+    float getModReleaseValue() const noexcept;
+
+    float getDelayTimeValue() const noexcept;
+
+    OscillatorModes getOscillatorMode() const noexcept;
+    bool getSampleStreaming() const noexcept;
+    float getSamplePreloadMs() const noexcept;
+
 private:
+    juce::SmoothedValue<float> gainSmoother, tremoloFreqSmoother, tremoloDepthSmoother, delayTimeSmoother,
+                               wavetablePositionSmoother;
+    bool hasCaptured = false;
+
     std::atomic<float>* waveParam      = nullptr; // choice stored as float index
     std::atomic<float>* gainDbParam    = nullptr; // -24..24
     std::atomic<float>* cutoffLowParam = nullptr; // Hz
     std::atomic<float>* cutoffHighParam= nullptr; // Hz
+    std::atomic<float>* filterLengthParam = nullptr; // choice stored as float index
+    std::atomic<float>* filterEngineParam = nullptr; // choice stored as float index
+    std::atomic<float>* polyphonyParam = nullptr; // 1..256 voices
+    std::atomic<float>* voiceStealingParam = nullptr; // choice stored as float index
+    std::atomic<float>* multiCoreParam = nullptr; // on or off
+    std::atomic<float>* oversamplingParam = nullptr;        // choice stored as float index
+    std::atomic<float>* oversamplingOfflineParam = nullptr; // choice stored as float index
+    std::atomic<float>* unisonVoicesParam = nullptr; // 1..16 oscillators
+    std::atomic<float>* unisonDetuneParam = nullptr; // cents
+    std::atomic<float>* unisonSpreadParam = nullptr; // 0 - 1
 
 	std::atomic<float>* attackParam = nullptr; // miliseconds
 	std::atomic<float>* decayParam = nullptr; // miliseconds
@@ -47,5 +142,35 @@ private:
 	std::atomic<float>* lfoWaveParam = nullptr; // choice stored as float index
 	std::atomic<float>* lfoFreqParam = nullptr; // Hz
 	std::atomic<float>* lfoDepthParam = nullptr; // 0 - 1
+
+    std::array<std::atomic<float>*, numModRoutes> modSourceParams{};      // choice stored as float index
+    std::array<std::atomic<float>*, numModRoutes> modDestinationParams{}; // choice stored as float index
+    std::array<std::atomic<float>*, numModRoutes> modAmountParams{};      // -1 - 1
+
+    std::array<std::atomic<float>*, numModLfos> modLfoWaveParams{};       // choice stored as float index
+    std::array<std::atomic<float>*, numModLfos> modLfoRateParams{};       // Hz
+
+    std::atomic<float>* modAttackParam = nullptr;  // miliseconds
+    std::atomic<float>* modDecayParam = nullptr;   // miliseconds
+    std::atomic<float>* modSustainParam = nullptr; // 0 - 1
+    std::atomic<float>* modReleaseParam = nullptr; // miliseconds
+
+    std::atomic<float>* chorusRateParam = nullptr;      // Hz
+    std::atomic<float>* chorusDepthParam = nullptr;     // 0 - 1
+    std::atomic<float>* chorusMixParam = nullptr;       // 0 - 1
+    std::atomic<float>* flangerRateParam = nullptr;     // Hz
+    std::atomic<float>* flangerDepthParam = nullptr;    // 0 - 1
+    std::atomic<float>* flangerFeedbackParam = nullptr; // -0.95 - 0.95
+    std::atomic<float>* flangerMixParam = nullptr;      // 0 - 1
+    std::atomic<float>* delayTimeParam = nullptr;       // miliseconds
+    std::atomic<float>* delayFeedbackParam = nullptr;   // 0 - 0.95
+    std::atomic<float>* delayMixParam = nullptr;        // 0 - 1
+
+    std::atomic<float>* oscillatorModeParam = nullptr;  // choice stored as float index
+    std::atomic<float>* sampleRootNoteParam = nullptr;  // MIDI note 0 - 127
+    std::atomic<float>* sampleLoopParam = nullptr;      // on or off
+    std::atomic<float>* sampleStreamingParam = nullptr; // on or off
+    std::atomic<float>* samplePreloadParam = nullptr;   // miliseconds
+    std::atomic<float>* wavetablePositionParam = nullptr; // 0 - 1
 };
 
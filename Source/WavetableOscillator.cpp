@@ -0,0 +1,90 @@
+/*
+  ==============================================================================
+
+    WavetableOscillator.cpp
+
+  ==============================================================================
+*/
+
+#include "WavetableOscillator.h"
+#include "SimpleFFT.h"
+
+namespace
+{
+    using WaveForms = WaveFormSettings::WaveForms;
+
+    // Fourier series of the shapes maxiOsc used to produce, with the phase in
+    // [0, 1): sin = sine, sq = -1 then +1, tri = -1 at 0 rising to +1 at 0.5,
+    // saw = ramp from -1 to +1. Harmonic k contributes cosAmp * cos + sinAmp * sin.
+    void harmonic(WaveForms wave, int k, float& cosAmp, float& sinAmp) noexcept
+    {
+        const float pi = juce::MathConstants<float>::pi;
+        cosAmp = sinAmp = 0.0f;
+
+        switch (wave)
+        {
+            case WaveForms::sine:
+                sinAmp = (k == 1) ? 1.0f : 0.0f;
+                break;
+            case WaveForms::square:
+                sinAmp = (k % 2 == 1) ? -4.0f / (pi * (float) k) : 0.0f;
+                break;
+            case WaveForms::triangle:
+                cosAmp = (k % 2 == 1) ? -8.0f / (pi * pi * (float) (k * k)) : 0.0f;
+                break;
+            case WaveForms::sawtooth:
+                sinAmp = -2.0f / (pi * (float) k);
+                break;
+        }
+    }
+}
+
+WavetableOscillator::Tables::Tables()
+    : data((size_t) 4 * numLevels * tableStride, 0.0f)
+{
+    SimpleFFT<float> fft(tableSize);
+    std::vector<SimpleFFT<float>::Complex> spectrum((size_t) tableSize);
+
+    for (auto wave : { WaveForms::sine, WaveForms::square, WaveForms::triangle, WaveForms::sawtooth })
+    {
+        for (int level = 0; level < numLevels; ++level)
+        {
+            std::fill(spectrum.begin(), spectrum.end(), SimpleFFT<float>::Complex());
+
+            // The inverse transform sums X[k] e^(+i 2 pi k n / N), so a real
+            // cos / sin component is split over bins k and N - k.
+            for (int k = 1; k <= (maxHarmonics >> level); ++k)
+            {
+                float cosAmp, sinAmp;
+                harmonic(wave, k, cosAmp, sinAmp);
+
+                spectrum[(size_t) k] = SimpleFFT<float>::Complex(0.5f * cosAmp, -0.5f * sinAmp);
+                spectrum[(size_t) (tableSize - k)] = std::conj(spectrum[(size_t) k]);
+            }
+
+            fft.inverse(spectrum.data());
+
+            float* table = data.data() + offset(wave, level);
+
+            for (int i = 0; i < tableSize; ++i)
+                table[i] = spectrum[(size_t) i].real();
+
+            for (int i = 0; i < numGuardSamples; ++i)
+                table[tableSize + i] = table[i];
+        }
+    }
+}
+
+void WavetableOscillator::setFrequency(double hz, const DspContext& context) noexcept
+{
+    phaseIncrement = context.oscillatorIncrement(hz);
+    level = levelFor(phaseIncrement);
+}
+
+int WavetableOscillator::levelFor(double increment) noexcept
+{
+    // Richest level whose top harmonic, maxHarmonics >> level, stays at or
+    // below Nyquist: level >= log2(maxHarmonics * 2 * hz / sampleRate).
+    const double needed = std::log2(maxHarmonics * 2.0 * increment);
+    return juce::jlimit(0, numLevels - 1, (int) std::ceil(needed));
+}
@@ -0,0 +1,211 @@
+/*
+  ==============================================================================
+
+    WavetableOscillator.h
+
+    Band-limited wavetable oscillator for the four WaveFormSettings shapes,
+    and for the frames of a user wavetable (see UserWavetables).
+
+    Each shape is stored as a set of mip levels, one per octave, each holding
+    half the harmonics of the level below. The tables don't depend on the
+    sample rate, so they are built once per process (by the first voice that
+    is constructed) and shared. A note picks the richest level whose top
+    harmonic still lies below Nyquist, and playback is a linearly
+    interpolated table lookup. A user wavetable plays two neighbouring
+    frames at once and crossfades between them by the wavetable position.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "WaveFormSettings.h"
+#include "DspContext.h"
+#include <vector>
+
+class WavetableOscillator
+{
+public:
+    static constexpr int tableSize = 2048;
+    static constexpr int numLevels = 10;
+    static constexpr int maxHarmonics = 512; // level 0; level n has maxHarmonics >> n
+    static constexpr int numGuardSamples = 2;
+    static constexpr int tableStride = tableSize + numGuardSamples;
+
+    // One level of a set of mip levels stored level after level, as Tables
+    // stores each wave's.
+    static const float* mipLevel(const float* mips, int level) noexcept
+    {
+        return mips + (size_t) level * tableStride;
+    }
+
+    class Tables
+    {
+    public:
+        Tables();
+
+        // tableSize samples plus two guard samples repeating the first two, so the
+        // interpolation never has to wrap (p * tableSize can round up to tableSize).
+        const float* get(WaveFormSettings::WaveForms wave, int level) const noexcept
+        {
+            return data.data() + offset(wave, level);
+        }
+
+    private:
+        std::vector<float> data;
+
+        static size_t offset(WaveFormSettings::WaveForms wave, int level) noexcept
+        {
+            return ((size_t) wave * numLevels + (size_t) level) * tableStride;
+        }
+
+        JUCE_DECLARE_NON_COPYABLE(Tables)
+    };
+
+    WavetableOscillator() = default;
+
+    // Picks the mip level for this pitch. Call at note-on, not per sample.
+    void setFrequency(double hz, const DspContext& context) noexcept;
+
+    void reset() noexcept { phase = 0.0; }
+
+    // Lane state for VoiceBank, which renders the oscillators of many voices together.
+    double getPhase() const noexcept { return phase; }
+    void setPhase(double newPhase) noexcept { phase = newPhase; }
+    double getIncrement() const noexcept { return phaseIncrement; }
+    int getLevel() const noexcept { return level; }
+
+    // Richest mip level that stays below Nyquist at this many cycles per sample.
+    static int levelFor(double increment) noexcept;
+
+    // The tables are stored in float; phase and interpolation run in SampleType.
+    template <typename SampleType>
+    void render(WaveFormSettings::WaveForms wave, SampleType* dest, int numSamples) noexcept
+    {
+        const float* table = tables->get(wave, level);
+
+        // Each phase is computed from the start of the block rather than
+        // accumulated, so iterations are independent of each other.
+        const SampleType start = (SampleType) phase;
+        const SampleType increment = (SampleType) phaseIncrement;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            SampleType p = start + (SampleType) i * increment;
+            p -= (SampleType) (int) p;
+
+            const SampleType position = p * (SampleType) tableSize;
+            const int index = (int) position;
+            const SampleType frac = position - (SampleType) index;
+            const SampleType a = table[index];
+            const SampleType b = table[index + 1];
+
+            dest[i] = a + frac * (b - a);
+        }
+
+        phase += numSamples * phaseIncrement;
+        phase -= std::floor(phase);
+    }
+
+    // Pitch-modulated variant: ratio[i] multiplies the note's frequency at
+    // sample i. The phase has to be accumulated here, so the only serial part
+    // is a running sum of the increments (no wrapping); wrapping and the table
+    // lookups are done in a second loop with independent iterations.
+    template <typename SampleType>
+    void render(WaveFormSettings::WaveForms wave, SampleType* dest, int numSamples, const SampleType* ratio) noexcept
+    {
+        // The mip level has to stay below Nyquist at the highest pitch in the block.
+        SampleType maxRatio = 0;
+
+        for (int i = 0; i < numSamples; ++i)
+            maxRatio = juce::jmax(maxRatio, ratio[i]);
+
+        const float* table = tables->get(wave, levelFor(phaseIncrement * (double) maxRatio));
+        const SampleType increment = (SampleType) phaseIncrement;
+        const SampleType start = (SampleType) phase;
+        SampleType travelled = 0;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            dest[i] = travelled;
+            travelled += ratio[i];
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            SampleType p = start + dest[i] * increment;
+            p -= (SampleType) (int) p;
+
+            const SampleType position = p * (SampleType) tableSize;
+            const int index = (int) position;
+            const SampleType frac = position - (SampleType) index;
+            const SampleType a = table[index];
+            const SampleType b = table[index + 1];
+
+            dest[i] = a + frac * (b - a);
+        }
+
+        phase += (double) travelled * phaseIncrement;
+        phase -= std::floor(phase);
+    }
+
+    // Two sets of mip levels, crossfaded: mix 0 plays mipsA, 1 plays mipsB.
+    // With pitchOn, ratio[i] multiplies the frequency as above.
+    template <typename SampleType, bool pitchOn>
+    void render(const float* mipsA, const float* mipsB, SampleType mix,
+                SampleType* dest, int numSamples, const SampleType* ratio) noexcept
+    {
+        int blockLevel = level;
+
+        if constexpr (pitchOn)
+        {
+            SampleType maxRatio = 0;
+
+            for (int i = 0; i < numSamples; ++i)
+                maxRatio = juce::jmax(maxRatio, ratio[i]);
+
+            blockLevel = levelFor(phaseIncrement * (double) maxRatio);
+        }
+
+        const float* tableA = mipLevel(mipsA, blockLevel);
+        const float* tableB = mipLevel(mipsB, blockLevel);
+        const SampleType increment = (SampleType) phaseIncrement;
+        const SampleType start = (SampleType) phase;
+        SampleType travelled = (SampleType) numSamples;
+
+        if constexpr (pitchOn)
+        {
+            travelled = 0;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                dest[i] = travelled;
+                travelled += ratio[i];
+            }
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            SampleType p = start + (pitchOn ? dest[i] : (SampleType) i) * increment;
+            p -= (SampleType) (int) p;
+
+            const SampleType position = p * (SampleType) tableSize;
+            const int index = (int) position;
+            const SampleType frac = position - (SampleType) index;
+            const SampleType a = tableA[index] + frac * (tableA[index + 1] - tableA[index]);
+            const SampleType b = tableB[index] + frac * (tableB[index + 1] - tableB[index]);
+
+            dest[i] = a + mix * (b - a);
+        }
+
+        phase += (double) travelled * phaseIncrement;
+        phase -= std::floor(phase);
+    }
+
+private:
+    juce::SharedResourcePointer<Tables> tables;
+
+    double phase = 0.0;          // 0..1
+    double phaseIncrement = 0.0; // cycles per sample
+    int level = 0;
+};
@@ -1,11 +1,31 @@
 #include "WavetableVoice.h"
 #include "WavetableSound.h"
+#include "SynthEngine.h"
 #include <juce_dsp/juce_dsp.h>
 
 using Coeff = juce::dsp::IIR::Coefficients<double>;
 
-WavetableVoice::WavetableVoice(WaveFormSettings& w)
-    : waveFormSettings(w) {}
+using Destinations = ModMatrix::Destinations;
+
+template <typename SampleType, size_t... indices>
+constexpr WavetableVoice::KernelTable<SampleType> WavetableVoice::makeKernelTable(std::index_sequence<indices...>) noexcept
+{
+    // Inverse of kernelIndex.
+    constexpr size_t routeSets = ModMatrix::numKernelRouteSets;
+
+    return { { &WavetableVoice::renderKernel<SampleType,
+                                             ((indices / (4 * routeSets)) & 1) != 0,
+                                             ((indices / (2 * routeSets)) & 1) != 0,
+                                             ((indices / routeSets) & 1) != 0,
+                                             (unsigned) (indices % routeSets)>... } };
+}
+
+template <typename SampleType>
+const WavetableVoice::KernelTable<SampleType> WavetableVoice::renderKernels
+    = WavetableVoice::makeKernelTable<SampleType>(std::make_index_sequence<numKernels>{});
+
+WavetableVoice::WavetableVoice(const ParameterSnapshot& p, const ModMatrix& m, const DspContext& c)
+    : parameters(p), modulation(m), context(c) {}
 
 bool WavetableVoice::canPlaySound(juce::SynthesiserSound* sound)
 {
@@ -16,85 +36,535 @@ void WavetableVoice::startNote(int midiNoteNumber, float velocity,
     juce::SynthesiserSound*, int /*currentPitchWheelPosition*/)
 {
     frequency = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
+    oscillator.setFrequency(frequency, context);
+    unison.setStack(parameters.unisonVoices, parameters.unisonDetune, parameters.unisonSpread);
+    unison.setFrequency(frequency, context);
+    unison.reset();
+
+    // The decimators would otherwise feed the last note's tail into this one.
+    floatState.oversampler.reset();
+    floatState.oversamplerRight.reset();
+    doubleState.oversampler.reset();
+    doubleState.oversamplerRight.reset();
+
+    // Only a note in "Sample" mode may take one of the reader's streams.
+    if (parameters.oscillatorMode == WaveFormSettings::OscillatorModes::sample)
+        sampler.start(parameters.sample, parameters.sampleStreaming ? parameters.zone : nullptr,
+                      frequency, parameters.sampleRootNote, parameters.sampleLoop, context);
+    else
+        sampler.stop();
     level = velocity * 0.15;
-    filter.setCutoff(waveFormSettings.getCutoffLowFrequency(), waveFormSettings.getCutoffHighFrequency());
+
+    if (filterEngine != WaveFormSettings::FilterEngines::fir)
+    {
+        floatState.iir.setCutoff(parameters.cutoffLow, parameters.cutoffHigh);
+        floatState.iirRight.setCutoff(parameters.cutoffLow, parameters.cutoffHigh);
+        doubleState.iir.setCutoff(parameters.cutoffLow, parameters.cutoffHigh);
+        doubleState.iirRight.setCutoff(parameters.cutoffLow, parameters.cutoffHigh);
+        cutoffOctaves = 0.0;
+        cutoffLowBase = parameters.cutoffLow;
+        cutoffHighBase = parameters.cutoffHigh;
+    }
+    else
+    {
+        // The FIRs only run while the filter is per voice, and then the
+        // cutoff is modulated, so every sub-block moves them. Leave it to
+        // the note's first one; with the filter on the bus they don't exist.
+        cutoffOctaves = std::numeric_limits<double>::quiet_NaN();
+    }
     
-    env.setAttackMS(waveFormSettings.getAttackValue());
-    env.setDecay(waveFormSettings.getDecayValue());
-    env.setSustain(waveFormSettings.getSustainValue());
-    env.setRelease(waveFormSettings.getReleaseValue());
+    env.setParameters(parameters.attack, parameters.decay, parameters.sustain, parameters.release);
+    env.noteOn(); // start attack
 
-    env.trigger = 1; // start attack
+    modEnv.setParameters(parameters.modAttack, parameters.modDecay, parameters.modSustain, parameters.modRelease);
+    modEnv.noteOn();
+
+    if (engine != nullptr)
+        engine->voiceStarted(*this);
 }
 
 void WavetableVoice::stopNote(float /*velocity*/, bool allowTailOff)
 {
-    env.trigger = 0; // start release
+    env.noteOff(); // start release
+    modEnv.noteOff();
+
     if (!allowTailOff)
+    {
+        env.reset();
+        modEnv.reset();
+        sampler.stop();
         clearCurrentNote(); // force cut
+    }
+}
+
+void WavetableVoice::renderNextBlock(juce::AudioBuffer<float>& outputBuffer,
+    int startSample, int numSamples)
+{
+    addToBuffer(outputBuffer, startSample, numSamples);
 }
 
-void WavetableVoice::renderNextBlock(juce::AudioSampleBuffer& outputBuffer,
+void WavetableVoice::renderNextBlock(juce::AudioBuffer<double>& outputBuffer,
     int startSample, int numSamples)
+{
+    addToBuffer(outputBuffer, startSample, numSamples);
+}
+
+int WavetableVoice::renderToSlots(float* left, float* right, int startSample, int numSamples)
+{
+    return renderIntoSlots(left, right, startSample, numSamples);
+}
+
+int WavetableVoice::renderToSlots(double* left, double* right, int startSample, int numSamples)
+{
+    return renderIntoSlots(left, right, startSample, numSamples);
+}
+
+bool WavetableVoice::canRenderInBank(bool doublePrecision) const noexcept
+{
+    return (!isFilterOn(doublePrecision) || filterEngine != WaveFormSettings::FilterEngines::fir)
+        && modulation.getKernelRoutes() == 0
+        && !modulation.isActive(Destinations::pan)
+        && parameters.unisonVoices == 1
+        && parameters.oscillatorMode == WaveFormSettings::OscillatorModes::wavetable
+        && parameters.userTable == nullptr
+        && context.oversamplingFactor == 1;
+}
+
+template <typename SampleType>
+void WavetableVoice::addToBuffer(juce::AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples)
+{
+    renderBlocks<SampleType>(startSample, numSamples,
+                             [&outputBuffer](int offset, const SampleType* left, const SampleType* right, int count)
+    {
+        for (int ch = outputBuffer.getNumChannels(); --ch >= 0;)
+        {
+            const SampleType* samples = (right != nullptr && (ch & 1) != 0) ? right : left;
+            juce::FloatVectorOperations::add(outputBuffer.getWritePointer(ch, offset), samples, count);
+        }
+    });
+}
+
+template <typename SampleType>
+int WavetableVoice::renderIntoSlots(SampleType* left, SampleType* right, int startSample, int numSamples)
+{
+    int numRendered = 0;
+
+    renderBlocks<SampleType>(startSample, numSamples,
+                             [&](int offset, const SampleType* l, const SampleType* r, int count)
+    {
+        juce::FloatVectorOperations::copy(left + (offset - startSample), l, count);
+
+        if (r != nullptr)
+            juce::FloatVectorOperations::copy(right + (offset - startSample), r, count);
+
+        numRendered = offset - startSample + count;
+    });
+
+    return numRendered;
+}
+
+template <typename SampleType, typename Sink>
+void WavetableVoice::renderBlocks(int startSample, int numSamples, Sink&& sink)
 {
     //auto coeffs = Coeff::makeHighPass(sampleRate, cutoffHz, Q);
 
-    if (env.trigger == 0 && envValue < 0.0001)
+    if (!env.isActive())
         return;
 
-    while (--numSamples >= 0)
+    auto& state = getState<SampleType>();
+
+    // Everything that can't change within the block is resolved here, once.
+    // The filter only exists in the precision the voice was prepared for.
+    // A sample plays on its own, without a unison stack.
+    const bool samplePlayback = parameters.oscillatorMode == WaveFormSettings::OscillatorModes::sample;
+    unison.setStack(samplePlayback ? 1 : parameters.unisonVoices, parameters.unisonDetune, parameters.unisonSpread);
+
+    const bool filterOn = isFilterOn(std::is_same_v<SampleType, double>);
+    const unsigned routes = modulation.getKernelRoutes();
+    // A band still to be placed (NaN) is placed by the same path, unmodulated or not.
+    const bool cutoffOn = filterOn && (modulation.isActive(Destinations::cutoff) || std::isnan(cutoffOctaves));
+    const bool panOn = modulation.isActive(Destinations::pan);
+    const bool stereo = unison.isStereo();
+    const auto kernel = renderKernels<SampleType>[kernelIndex(filterOn, state.lfo != nullptr, stereo, routes)];
+
+    while (numSamples > 0)
     {
-        envValue = env.adsr(1.0, env.trigger);
+        const int blockSize = juce::jmin(numSamples, renderBlockSize);
+        const int numToRender = env.render(state.envBlock.data(), blockSize);
+        const bool finished = !env.isActive();
+
+        gainStart = level * parameters.gain.at(startSample);
+        gainStep = level * parameters.gain.step;
+        wavetablePosition = parameters.wavetablePosition.at(startSample);
 
-        double sample = filter.processSample(getNextSample());
-        sample = amplify(sample * level * envValue * globalLfoData[startSample]);
+        renderModulation<SampleType>(startSample, numToRender, routes, panOn);
 
-        for (int i = outputBuffer.getNumChannels(); --i >= 0;)
-            outputBuffer.addSample(i, startSample, sample);
+        if (cutoffOn)
+            applyCutoffModulation<SampleType>(startSample);
 
-        ++startSample;
+        (this->*kernel)(numToRender, state.lfo != nullptr ? state.lfo + startSample : nullptr);
 
-        if (env.trigger == 0 && envValue < 0.0001)
+        const SampleType* right = stereo ? state.blockRight.data() : state.block.data();
+
+        if (panOn)
+        {
+            // The gains become the panned signal, so the sink only has to add.
+            juce::FloatVectorOperations::multiply(state.panLeft.data(), state.block.data(), numToRender);
+            juce::FloatVectorOperations::multiply(state.panRight.data(), right, numToRender);
+            sink(startSample, state.panLeft.data(), state.panRight.data(), numToRender);
+        }
+        else
+        {
+            sink(startSample, state.block.data(), stereo ? right : nullptr, numToRender);
+        }
+
+        // A one-shot sample that has played out has nothing left to release.
+        if (finished || (samplePlayback && sampler.hasEnded()))
+        {
+            // An IIR would otherwise ring on into the voice's next note.
+            state.iir.reset();
+            state.iirRight.reset();
+            sampler.stop();
             clearCurrentNote();
+            return;
+        }
+
+        startSample += blockSize;
+        numSamples -= blockSize;
     }
 }
 
-double WavetableVoice::amplify(double sample) const
+template <typename SampleType, bool filterOn, bool lfoOn, bool stereo, unsigned routes>
+void WavetableVoice::renderKernel(int numSamples, const SampleType* lfo) noexcept
 {
-	return sample * waveFormSettings.getVelocity();
+    auto& state = getState<SampleType>();
+    SampleType* samples = state.block.data();
+    SampleType* samplesRight = state.blockRight.data();
+    const SampleType* envelope = state.envBlock.data();
+    const SampleType* amplitude = state.amplitudeGain.data();
+    const SampleType start = (SampleType) gainStart;
+    const SampleType step = (SampleType) gainStep;
+
+    renderOscillator<SampleType, (routes & ModMatrix::pitchRoute) != 0, stereo>(samples, samplesRight, numSamples);
+
+    if constexpr (filterOn)
+        applyFilter<SampleType, stereo>(samples, samplesRight, numSamples);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        SampleType g = envelope[i] * (start + step * (SampleType) i);
+
+        if constexpr (lfoOn)
+            g *= lfo[i];
+
+        if constexpr ((routes & ModMatrix::amplitudeRoute) != 0)
+            g *= amplitude[i];
+
+        samples[i] *= g;
+
+        if constexpr (stereo)
+            samplesRight[i] *= g;
+    }
 }
 
-void WavetableVoice::setCurrentPlaybackSampleRate(double newRate)
+template <typename SampleType, bool pitchOn, bool stereo>
+void WavetableVoice::renderUserTable(const UserWavetables::Table& table, SampleType* left, SampleType* right,
+                                     int numSamples, const SampleType* ratio) noexcept
 {
-    prepare(newRate);
+    // The two frames either side of the position, crossfaded sample by
+    // sample inside the oscillator's loop.
+    float mix = 0.0f;
+    const int first = table.findFrame(wavetablePosition, mix);
+    const float* mipsA = table.getFrame(first);
+    const float* mipsB = table.getFrame(juce::jmin(first + 1, table.getNumFrames() - 1));
+
+    if (stereo || unison.getNumLanes() > 1)
+        unison.render<SampleType, stereo, pitchOn>(mipsA, mipsB, (SampleType) mix, left, right, numSamples, ratio);
+    else
+        oscillator.render<SampleType, pitchOn>(mipsA, mipsB, (SampleType) mix, left, numSamples, ratio);
 }
 
-double WavetableVoice::getNextSample()
+template <typename SampleType, bool pitchOn, bool stereo>
+void WavetableVoice::renderOscillator(SampleType* left, SampleType* right, int numSamples) noexcept
 {
-    auto c = waveFormSettings.getSelectedWaveForm();
+    auto& state = getState<SampleType>();
+    const int factor = state.oversampler.getFactor();
+    const bool oversampled = factor > 1;
 
-    switch (c) {
-        case WaveFormSettings::WaveForms::sine: {
-            return osc.sinewave(frequency);
-        }
-        case WaveFormSettings::WaveForms::square: {
-            return osc.square(frequency);
-        }
-        case WaveFormSettings::WaveForms::triangle: {
-            return osc.triangle(frequency);
+    SampleType* oscLeft = oversampled ? state.oversampledBlock.data() : left;
+    SampleType* oscRight = oversampled ? state.oversampledBlockRight.data() : right;
+    const int numOscSamples = numSamples * factor;
+    const SampleType* ratio = state.pitchRatio.data();
+    const auto wave = parameters.wave;
+
+    if (pitchOn && oversampled)
+    {
+        SampleType* held = state.oversampledRatio.data();
+
+        for (int i = 0; i < numSamples; ++i)
+            for (int k = 0; k < factor; ++k)
+                held[i * factor + k] = state.pitchRatio[(size_t) i];
+
+        ratio = held;
+    }
+
+    if (parameters.oscillatorMode == WaveFormSettings::OscillatorModes::sample)
+        sampler.render<SampleType, pitchOn>(oscLeft, numOscSamples, ratio);
+    else if (const auto* table = parameters.userTable)
+        renderUserTable<SampleType, pitchOn, stereo>(*table, oscLeft, oscRight, numOscSamples, ratio);
+    else if (stereo || unison.getNumLanes() > 1)
+        unison.render<SampleType, stereo, pitchOn>(wave, oscLeft, oscRight, numOscSamples, ratio);
+    else if constexpr (pitchOn)
+        oscillator.render(wave, oscLeft, numOscSamples, ratio);
+    else
+        oscillator.render(wave, oscLeft, numOscSamples);
+
+    if (oversampled)
+    {
+        state.oversampler.process(oscLeft, left, numSamples);
+
+        if constexpr (stereo)
+            state.oversamplerRight.process(oscRight, right, numSamples);
+    }
+}
+
+template <typename SampleType>
+void WavetableVoice::prepareBankBlock(int startSample, int numSamples, bool filterOn) noexcept
+{
+    renderModulation<SampleType>(startSample, numSamples, 0, false);
+
+    if (filterOn && (modulation.isActive(Destinations::cutoff) || std::isnan(cutoffOctaves)))
+        applyCutoffModulation<SampleType>(startSample);
+}
+
+template void WavetableVoice::prepareBankBlock<float>(int, int, bool) noexcept;
+template void WavetableVoice::prepareBankBlock<double>(int, int, bool) noexcept;
+
+template <typename SampleType, bool stereo>
+void WavetableVoice::applyFilter(SampleType* left, SampleType* right, int numSamples) noexcept
+{
+    auto& state = getState<SampleType>();
+
+    if (filterEngine == WaveFormSettings::FilterEngines::fir)
+    {
+        state.filter.process(left, left, numSamples);
+
+        if constexpr (stereo)
+            state.filterRight.process(right, right, numSamples);
+    }
+    else
+    {
+        state.iir.process(left, left, numSamples);
+
+        if constexpr (stereo)
+            state.iirRight.process(right, right, numSamples);
+    }
+}
+
+template <typename SampleType>
+void WavetableVoice::renderModulation(int startSample, int numSamples, unsigned routes, bool panOn) noexcept
+{
+    auto& state = getState<SampleType>();
+
+    // The envelope only runs while something reads it.
+    if (modulation.usesModEnvelope())
+    {
+        const int numRendered = modEnv.render(state.modEnvBlock.data(), numSamples);
+        juce::FloatVectorOperations::clear(state.modEnvBlock.data() + numRendered, numSamples - numRendered);
+    }
+
+    if ((routes & ModMatrix::pitchRoute) != 0)
+    {
+        SampleType* ratio = state.pitchRatio.data();
+        combineModulation(Destinations::pitch, ratio, startSample, numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+            ratio[i] = ModMatrix::octavesToRatio(ratio[i]);
+    }
+
+    if ((routes & ModMatrix::amplitudeRoute) != 0)
+    {
+        SampleType* gain = state.amplitudeGain.data();
+        combineModulation(Destinations::amplitude, gain, startSample, numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+            gain[i] = juce::jmax((SampleType) 0, (SampleType) 1 + gain[i]);
+    }
+
+    if (panOn)
+    {
+        // Balance law: the centre keeps both channels at full level, as unpanned voices are.
+        SampleType* left = state.panLeft.data();
+        SampleType* right = state.panRight.data();
+        combineModulation(Destinations::pan, right, startSample, numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const SampleType pan = juce::jlimit((SampleType) -1, (SampleType) 1, right[i]);
+            left[i] = (SampleType) 1 - pan;
+            right[i] = (SampleType) 1 + pan;
         }
-        case WaveFormSettings::WaveForms::sawtooth: {
-			return osc.saw(frequency);
-		}
     }
 }
 
-void WavetableVoice::prepare(int sampleRate)
+template <typename SampleType>
+void WavetableVoice::combineModulation(Destinations d, SampleType* dest, int startSample, int numSamples) noexcept
+{
+    const auto& state = getState<SampleType>();
+    const SampleType* lfo = modulation.getLfoModulation<SampleType>(d);
+    const SampleType amount = (SampleType) modulation.getEnvelopeAmount(d);
+    const SampleType* envelope = state.modEnvBlock.data();
+
+    if (lfo == nullptr)
+        juce::FloatVectorOperations::copyWithMultiply(dest, envelope, amount, numSamples);
+    else if (amount == 0)
+        juce::FloatVectorOperations::copy(dest, lfo + startSample, numSamples);
+    else
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = lfo[startSample + i] + amount * envelope[i];
+}
+
+template <typename SampleType>
+void WavetableVoice::applyCutoffModulation(int startSample) noexcept
+{
+    auto& state = getState<SampleType>();
+    const SampleType* lfo = modulation.getLfoModulation<SampleType>(Destinations::cutoff);
+
+    double octaves = modulation.getEnvelopeAmount(Destinations::cutoff) * (double) state.modEnvBlock[0];
+
+    if (lfo != nullptr)
+        octaves += (double) lfo[startSample];
+
+    // The kernel bank only has stepsPerOctave kernels per octave, so smaller
+    // moves would pick the same kernels again. The IIR sections are cheap
+    // enough to follow every move.
+    const bool useFir = filterEngine == WaveFormSettings::FilterEngines::fir;
+    const double minimumMove = useFir ? 1.0 / FIRKernelBank::stepsPerOctave : 0.0;
+
+    // A held offset still has to follow the cutoff knobs.
+    const bool baseMoved = parameters.cutoffLow != cutoffLowBase || parameters.cutoffHigh != cutoffHighBase;
+
+    if (!baseMoved && (octaves == cutoffOctaves || std::abs(octaves - cutoffOctaves) < minimumMove))
+        return;
+
+    cutoffOctaves = octaves;
+    cutoffLowBase = parameters.cutoffLow;
+    cutoffHighBase = parameters.cutoffHigh;
+
+    const float ratio = (float) std::exp2(octaves);
+    const float low = juce::jlimit(20.0f, 20000.0f, parameters.cutoffLow * ratio);
+    const float high = juce::jlimit(20.0f, 20000.0f, parameters.cutoffHigh * ratio);
+
+    if (useFir)
+    {
+        state.filter.setCutoff(low, high);
+        state.filterRight.setCutoff(low, high);
+    }
+    else
+    {
+        state.iir.setCutoff(low, high);
+        state.iirRight.setCutoff(low, high);
+    }
+}
+
+void WavetableVoice::setCurrentPlaybackSampleRate(double newRate)
+{
+    // The processor fills in the context before the synth passes the rate on.
+    jassert(newRate == context.sampleRate);
+
+    juce::SynthesiserVoice::setCurrentPlaybackSampleRate(newRate);
+    prepare();
+}
+
+void WavetableVoice::prepare()
+{
+    const double sampleRate = context.sampleRate;
+    const int oversamplingFactor = context.oversamplingFactor;
+
+    env.prepare(context);
+    modEnv.prepare(context);
+
+    // A table left over from a previous configuration would give wrong
+    // kernels, and the FIRs need one either way, so fetch the right one.
+    const bool tableMatches = kernelTable != nullptr
+                           && kernelTable->taps == filterTaps
+                           && kernelTable->sampleRate == sampleRate;
+    auto table = kernelTable;
+
+    if (filterEngine == WaveFormSettings::FilterEngines::fir && perVoiceFir && !tableMatches)
+        table = kernelBank->getTable(sampleRate, filterTaps);
+
+    // Both precisions get the oversampler: it is small, and the oscillator
+    // runs at the oversampled rate whichever one renders.
+    const auto oversampledSize = (size_t) (renderBlockSize * oversamplingFactor);
+
+    floatState.oversampler = Oversampler<float>{ oversamplingFactor, renderBlockSize };
+    floatState.oversamplerRight = Oversampler<float>{ oversamplingFactor, renderBlockSize };
+    floatState.oversampledBlock.assign(oversampledSize, 0.0f);
+    floatState.oversampledBlockRight.assign(oversampledSize, 0.0f);
+    floatState.oversampledRatio.assign(oversampledSize, 1.0f);
+    doubleState.oversampler = Oversampler<double>{ oversamplingFactor, renderBlockSize };
+    doubleState.oversamplerRight = Oversampler<double>{ oversamplingFactor, renderBlockSize };
+    doubleState.oversampledBlock.assign(oversampledSize, 0.0);
+    doubleState.oversampledBlockRight.assign(oversampledSize, 0.0);
+    doubleState.oversampledRatio.assign(oversampledSize, 1.0);
+
+    if (frequency > 0.0f)
+    {
+        oscillator.setFrequency(frequency, context);
+        unison.setFrequency(frequency, context);
+        sampler.setFrequency(frequency, context);
+    }
+
+    // New FIRs start at their default band; the next sub-block moves them.
+    cutoffOctaves = std::numeric_limits<double>::quiet_NaN();
+
+    // Only the precision in use gets filters; the other one releases its memory.
+    // The right-hand filter only runs while a unison stack is spread.
+    if (filterEngine != WaveFormSettings::FilterEngines::fir)
+    {
+        floatState.filter = floatState.filterRight = {};
+        doubleState.filter = doubleState.filterRight = {};
+
+        if (context.doublePrecision)
+            doubleState.iir = doubleState.iirRight = IIRBandFilter<double>{ sampleRate, filterEngine };
+        else
+            floatState.iir = floatState.iirRight = IIRBandFilter<float>{ sampleRate, filterEngine };
+    }
+    else if (!perVoiceFir)
+    {
+        floatState.filter = floatState.filterRight = {};
+        doubleState.filter = doubleState.filterRight = {};
+    }
+    else if (context.doublePrecision)
+    {
+        doubleState.filter = FIRFilter<double>{ filterTaps, sampleRate, table };
+        doubleState.filterRight = FIRFilter<double>{ filterTaps, sampleRate, table };
+        floatState.filter = {};
+        floatState.filterRight = {};
+    }
+    else
+    {
+        floatState.filter = FIRFilter<float>{ filterTaps, sampleRate, table };
+        floatState.filterRight = FIRFilter<float>{ filterTaps, sampleRate, table };
+        doubleState.filter = {};
+        doubleState.filterRight = {};
+    }
+}
+
+int WavetableVoice::getOversamplingLatencySamples() const noexcept
 {
-	filter = FIRFilter{ 101, static_cast<float>(sampleRate) };
+    return juce::roundToInt(floatState.oversampler.getLatencySamples());
 }
 
-void WavetableVoice::setGlobalLfo(const double* data)
+int WavetableVoice::getFilterLatencySamples() const noexcept
 {
-	globalLfoData = data;
+    if (filterEngine != WaveFormSettings::FilterEngines::fir)
+        return 0;
+
+    // Whether or not this voice's FIRs exist; the bus filter has the same latency.
+    const int bufferingLatency = FIRKernelBank::isPartitioned(filterTaps) ? FIRKernelBank::partitionSize : 0;
+
+    // Linear-phase group delay plus the partitioned convolution's buffering.
+    return (filterTaps - 1) / 2 + bufferingLatency;
 }
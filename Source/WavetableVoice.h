@@ -10,42 +10,282 @@
 
 #pragma once
 #include <JuceHeader.h>
-#include "WaveFormSettings.h"
+#include "ParameterSnapshot.h"
+#include "ModMatrix.h"
+#include "DspContext.h"
 #include "FIRfilter.h"
-#include "maximilian.h"
+#include "IIRBandFilter.h"
+#include "Oversampler.h"
+#include "WavetableOscillator.h"
+#include "UnisonOscillator.h"
+#include "SampleOscillator.h"
+#include "SegmentEnvelope.h"
 #include <juce_dsp/juce_dsp.h>
+#include <array>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class SynthEngine;
 
 class WavetableVoice : public juce::SynthesiserVoice
 {
 public:
-    WavetableVoice(WaveFormSettings& w);
+    // The snapshot is refilled, and the matrix processed, by the processor at
+    // the start of every block. The context belongs to the processor too and
+    // only changes while the voices are being prepared.
+    WavetableVoice(const ParameterSnapshot& parameters, const ModMatrix& modulation, const DspContext& context);
 
     bool canPlaySound(juce::SynthesiserSound* sound) override;
     void startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound*, int currentPitchWheelPosition) override;
     void stopNote(float velocity, bool allowTailOff) override;
     void pitchWheelMoved(int) override {}
     void controllerMoved(int, int) override {}
-    void renderNextBlock(juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override;
+    void renderNextBlock(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override;
+    void renderNextBlock(juce::AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override;
+
+    // Renders what renderNextBlock would add, overwriting [0 .. result) of the
+    // slots: when the voice is stereo left and right are for the even and odd
+    // channels, otherwise left alone is added to every channel and right is
+    // untouched. Used by SynthEngine's multi-core path.
+    int renderToSlots(float* left, float* right, int startSample, int numSamples);
+    int renderToSlots(double* left, double* right, int startSample, int numSamples);
+
+    // Pan is modulated or the unison stack is spread; as of the last render.
+    bool isStereo() const noexcept
+    {
+        return modulation.isActive(ModMatrix::Destinations::pan) || unison.isStereo();
+    }
     void setCurrentPlaybackSampleRate(double newRate) override;
-    void prepare(int sampleRate);
-    void setGlobalLfo(const double* data);
+
+    // Builds the filters and oversamplers for the context's rate, oversampling
+    // factor and precision. Rendering in the other precision still works, but
+    // without the per-voice filter.
+    void prepare();
+
+    void setFilterLength(int numTaps) { filterTaps = numTaps; }
+    void setFilterEngine(WaveFormSettings::FilterEngines engine) { filterEngine = engine; }
+    void setKernelTable(FIRKernelBank::Table::Ptr table) { kernelTable = std::move(table); }
+    int getFilterLatencySamples() const noexcept;
+
+    int getOversamplingLatencySamples() const noexcept;
+    void setGlobalLfo(const float* data) noexcept { floatState.lfo = data; }
+    void setGlobalLfo(const double* data) noexcept { doubleState.lfo = data; }
+
+    // The voice's ring in the processor's SampleStreamer.
+    void setSampleStream(SampleStreamer::Stream* stream) noexcept { sampler.setStream(stream); }
+
+    // When off the voice leaves filtering to the processor's global filter bus.
+    void setFilterEnabled(bool shouldFilter) noexcept
+    {
+        // The filters haven't followed the cutoff, nor heard this voice,
+        // while the bus filtered; what they still hold is from before.
+        if (shouldFilter && !filterEnabled)
+        {
+            cutoffOctaves = std::numeric_limits<double>::quiet_NaN();
+            resetFilters(floatState);
+            resetFilters(doubleState);
+        }
+
+        filterEnabled = shouldFilter;
+    }
+
+    // Whether prepare() builds the per-voice FIRs, which only the per-voice
+    // filter routing uses. Without them the voice must not filter with the
+    // FIR engine. The IIR sections are small and always built.
+    void setPerVoiceFir(bool shouldBuild) noexcept { perVoiceFir = shouldBuild; }
+
+    // Takes over a pair of FIRs built for a voice that was prepared without
+    // them, so the processor can add them while it plays. The voice's own
+    // are empty then, so the moves free nothing: realtime safe.
+    template <typename SampleType>
+    void adoptFirs(FIRFilter<SampleType>& left, FIRFilter<SampleType>& right) noexcept
+    {
+        jassert(!perVoiceFir);
+
+        auto& state = getState<SampleType>();
+        state.filter = std::move(left);
+        state.filterRight = std::move(right);
+
+        perVoiceFir = true;
+        cutoffOctaves = std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // A single wavetable oscillator at the host rate with no per-sample
+    // modulation and no filter, or an IIR one, which VoiceBank can render
+    // alongside other voices. Checked after the block's options have been set.
+    bool canRenderInBank(bool doublePrecision) const noexcept;
+
+    // The voice filters its output when rendering in this precision.
+    bool isFilterOn(bool doublePrecision) const noexcept
+    {
+        return filterEnabled && context.doublePrecision == doublePrecision;
+    }
+
+    // Velocity level times the current envelope value, used to find the quietest voice.
+    float getCurrentLevel() const noexcept { return (float) (level * env.getValue()); }
 
 private:
-    double getNextSample();
-    double amplify(double sample) const;
+    // The voice is rendered in sub-blocks of this size by one of the kernels
+    // below, specialised per filter / tremolo on-off state, mono or stereo
+    // output and the set of per-sample modulation routes; the waveform is
+    // just the table the oscillator reads. Parameters are read once per block
+    // and the kernel is picked from a table, so the per-sample loops contain
+    // no atomics, switches or libm calls.
+    static constexpr int renderBlockSize = 128;
+
+    // Everything the kernels touch, in the precision the host renders in.
+    // Only the state matching the context's precision has prepared filters,
+    // and only those of the selected engine. The ...Right members carry the
+    // second channel of a spread unison stack.
+    template <typename SampleType>
+    struct RenderState
+    {
+        std::array<SampleType, renderBlockSize> block{};
+        std::array<SampleType, renderBlockSize> blockRight{};
+        std::array<SampleType, renderBlockSize> envBlock{};
+        std::array<SampleType, renderBlockSize> modEnvBlock{};
+        std::array<SampleType, renderBlockSize> pitchRatio{};
+        std::array<SampleType, renderBlockSize> amplitudeGain{};
+        std::array<SampleType, renderBlockSize> panLeft{};
+        std::array<SampleType, renderBlockSize> panRight{};
+        FIRFilter<SampleType> filter;
+        FIRFilter<SampleType> filterRight;
+        IIRBandFilter<SampleType> iir;
+        IIRBandFilter<SampleType> iirRight;
+        Oversampler<SampleType> oversampler;
+        Oversampler<SampleType> oversamplerRight;
+        std::vector<SampleType> oversampledBlock;  // renderBlockSize * factor
+        std::vector<SampleType> oversampledBlockRight;
+        std::vector<SampleType> oversampledRatio;  // pitch ratio held for each oversampled sample
+        const SampleType* lfo = nullptr;
+    };
+
+    RenderState<float> floatState;
+    RenderState<double> doubleState;
+
+    template <typename SampleType>
+    RenderState<SampleType>& getState() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleState;
+        else
+            return floatState;
+    }
+
+    template <typename SampleType>
+    static void resetFilters(RenderState<SampleType>& state) noexcept
+    {
+        state.filter.reset();
+        state.filterRight.reset();
+        state.iir.reset();
+        state.iirRight.reset();
+    }
+
+    template <typename SampleType>
+    using RenderKernel = void (WavetableVoice::*)(int numSamples, const SampleType* lfo) noexcept;
+
+    // Every combination of [filter on][tremolo on][stereo][kernel routes],
+    // generated from the index by makeKernelTable. The waveform is not a
+    // dimension: the oscillator reads its table at run time either way.
+    static constexpr size_t numKernels = 2 * 2 * 2 * ModMatrix::numKernelRouteSets;
+
+    template <typename SampleType>
+    using KernelTable = std::array<RenderKernel<SampleType>, numKernels>;
+
+    template <typename SampleType>
+    static const KernelTable<SampleType> renderKernels;
+
+    static constexpr size_t kernelIndex(bool filterOn, bool lfoOn, bool stereo, unsigned routes) noexcept
+    {
+        return (((size_t) (filterOn ? 1 : 0) * 2 + (lfoOn ? 1 : 0)) * 2 + (stereo ? 1 : 0))
+                   * ModMatrix::numKernelRouteSets + routes;
+    }
+
+    template <typename SampleType, size_t... indices>
+    static constexpr KernelTable<SampleType> makeKernelTable(std::index_sequence<indices...>) noexcept;
+
+    template <typename SampleType>
+    void addToBuffer(juce::AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples);
+
+    template <typename SampleType>
+    int renderIntoSlots(SampleType* left, SampleType* right, int startSample, int numSamples);
+
+    // Renders sub-blocks and hands each one to sink(startSample, left, right, count).
+    // right is nullptr unless the voice is stereo; then left and right are
+    // the signal for the even and odd channels.
+    template <typename SampleType, typename Sink>
+    void renderBlocks(int startSample, int numSamples, Sink&& sink);
+
+    template <typename SampleType, bool filterOn, bool lfoOn, bool stereo, unsigned routes>
+    void renderKernel(int numSamples, const SampleType* lfo) noexcept;
+
+    // The oscillator, the unison stack when it has more than one lane, or
+    // in "Sample" mode the sample, at the oversampled rate and decimated
+    // into left (and right when stereo). A user wavetable plays in place of
+    // the waveform when one is selected.
+    template <typename SampleType, bool pitchOn, bool stereo>
+    void renderOscillator(SampleType* left, SampleType* right, int numSamples) noexcept;
+
+    template <typename SampleType, bool pitchOn, bool stereo>
+    void renderUserTable(const UserWavetables::Table& table, SampleType* left, SampleType* right,
+                         int numSamples, const SampleType* ratio) noexcept;
+
+    // Mod envelope plus LFO routes into the per-sample destination buffers.
+    template <typename SampleType>
+    void renderModulation(int startSample, int numSamples, unsigned routes, bool panOn) noexcept;
+
+    template <typename SampleType>
+    void combineModulation(ModMatrix::Destinations d, SampleType* dest, int startSample, int numSamples) noexcept;
+
+    // VoiceBank's share of renderBlocks for one sub-block: the mod envelope
+    // and, when filtering, the cutoff. The bank renders the rest.
+    template <typename SampleType>
+    void prepareBankBlock(int startSample, int numSamples, bool filterOn) noexcept;
+
+    // Runs the block through the selected filter engine.
+    template <typename SampleType, bool stereo>
+    void applyFilter(SampleType* left, SampleType* right, int numSamples) noexcept;
+
+    // Moves the filter band when the cutoff is modulated; once per sub-block.
+    template <typename SampleType>
+    void applyCutoffModulation(int startSample) noexcept;
 
     // These must be declared here:
     double level = 0.0;
     double tailOff = 0.0;
     float frequency = 0;
+    double gainStart = 0.0;      // note level * output gain ramp, resolved per sub-block
+    double gainStep = 0.0;
+    float wavetablePosition = 0; // through a user table, resolved per sub-block
 
-	const double* globalLfoData = nullptr;
-
-    double envValue = 0.0;
+    const ParameterSnapshot& parameters;
+    const ModMatrix& modulation;
+    const DspContext& context;
 
-    WaveFormSettings& waveFormSettings;
+    WavetableOscillator oscillator;
+    UnisonOscillator unison;
+    SampleOscillator sampler;
+    SegmentEnvelope env;
+    SegmentEnvelope modEnv;
+    double cutoffOctaves = 0.0;  // modulation the filter band was last moved by; NaN to move it regardless
+    float cutoffLowBase = 0.0f, cutoffHighBase = 0.0f; // the cutoffs it was moved from
+    bool filterEnabled = true;
+    bool perVoiceFir = true;
+    int filterTaps = 101;
+    WaveFormSettings::FilterEngines filterEngine = WaveFormSettings::FilterEngines::fir;
+    FIRKernelBank::Table::Ptr kernelTable;
+    juce::SharedResourcePointer<FIRKernelBank> kernelBank; // for a table prepare() wasn't given
 
-	maxiOsc osc;
-	maxiEnv env;
-    FIRFilter filter;
+    // Bookkeeping owned by SynthEngine: links in its list of sounding voices,
+    // or the position in its free stack while idle.
+    friend class SynthEngine;
+    friend class VoiceBank;
+    SynthEngine* engine = nullptr;
+    WavetableVoice* previousActive = nullptr;
+    WavetableVoice* nextActive = nullptr;
+    bool isInActiveList = false;
+    bool inVoiceBank = false;    // rendered by the engine's VoiceBank this block
+    int freeIndex = -1;
 };